@@ -0,0 +1,57 @@
+// MIT License
+//
+// Copyright(c) 2023 Matthieu Bucchianeri
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this softwareand associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright noticeand this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <algorithm>
+
+#include "arena.h"
+
+namespace quadinator {
+
+    void* FrameArena::Allocate(size_t size, size_t alignment) {
+        for (; m_block < m_blocks.size(); m_block++, m_offset = 0) {
+            auto& block = m_blocks[m_block];
+            const size_t offset = (m_offset + alignment - 1) & ~(alignment - 1);
+            if (offset + size <= block.size) {
+                m_offset = offset + size;
+                return reinterpret_cast<std::byte*>(block.data.get()) + offset;
+            }
+        }
+
+        // Grow. Oversized allocations get a block of their own.
+        const size_t blockSize = std::max(m_blockSize, size);
+        const size_t count = (blockSize + sizeof(std::max_align_t) - 1) / sizeof(std::max_align_t);
+        m_blocks.push_back({std::make_unique<std::max_align_t[]>(count), count * sizeof(std::max_align_t)});
+        m_block = m_blocks.size() - 1;
+        m_offset = size;
+        return m_blocks.back().data.get();
+    }
+
+    size_t FrameArena::capacity() const {
+        size_t capacity = 0;
+        for (const auto& block : m_blocks) {
+            capacity += block.size;
+        }
+        return capacity;
+    }
+
+} // namespace quadinator
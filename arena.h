@@ -0,0 +1,80 @@
+// MIT License
+//
+// Copyright(c) 2023 Matthieu Bucchianeri
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this softwareand associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright noticeand this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+// Scratch memory for the frame submission, shared between the DLL hooks and the offline tools.
+// This header must remain portable (no Windows or Detours dependencies).
+
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+namespace quadinator {
+
+    // A bump allocator for the copies made while submitting a frame. The blocks are kept from frame to frame: once the
+    // arena has grown to what the application submits, allocating from it does not call into the heap. Allocations
+    // never move, and remain valid until the next Reset().
+    class FrameArena {
+      public:
+        static constexpr size_t DefaultBlockSize = 4096;
+
+        explicit FrameArena(size_t blockSize = DefaultBlockSize) : m_blockSize(blockSize) {
+        }
+
+        // The memory is not initialized. The alignment must be a power-of-two, at most alignof(std::max_align_t).
+        void* Allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+
+        // Copy an array of plain structures (eg: the views of a layer).
+        template <typename T>
+        T* Copy(const T* values, size_t count = 1) {
+            static_assert(std::is_trivially_copyable_v<T> && alignof(T) <= alignof(std::max_align_t));
+            auto* const copy = static_cast<T*>(Allocate(sizeof(T) * count, alignof(T)));
+            std::memcpy(copy, values, sizeof(T) * count);
+            return copy;
+        }
+
+        // Release all the allocations, keeping the blocks.
+        void Reset() {
+            m_block = 0;
+            m_offset = 0;
+        }
+
+        // Total size of the blocks.
+        size_t capacity() const;
+
+      private:
+        struct Block {
+            std::unique_ptr<std::max_align_t[]> data;
+            size_t size;
+        };
+
+        const size_t m_blockSize;
+        std::vector<Block> m_blocks;
+        size_t m_block{0};
+        size_t m_offset{0};
+    };
+
+} // namespace quadinator
@@ -0,0 +1,384 @@
+// MIT License
+//
+// Copyright(c) 2023 Matthieu Bucchianeri
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this softwareand associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright noticeand this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "config.h"
+#include "tracing.h"
+
+namespace {
+
+    using namespace quadinator;
+    using namespace quadinator::config;
+
+    // How often the watcher looks at the configuration file.
+    constexpr auto WatchInterval = std::chrono::milliseconds(500);
+
+    // Largest PPD scale accepted. The texture sizes must remain within the range of the runtime.
+    constexpr double MaxPpdScale = 4.0;
+
+    // The latest snapshot. The readers share the ownership of the snapshot they use, so a replaced snapshot is freed
+    // by its last reader. Never destroyed, since the hooks may still run while the process exits.
+    std::shared_ptr<const Config>& g_currentConfig = *new std::shared_ptr<const Config>(std::make_shared<Config>());
+
+    using Entries = std::vector<std::pair<std::string, std::string>>;
+
+    // Serializes the publishers (watcher and control channel) and protects the state below. Readers never take it.
+    std::mutex g_publishMutex;
+
+    // The settings changed through the control channel. They are applied on top of the file upon each reload.
+    Entries g_overrides;
+
+    std::string ToLower(std::string_view str) {
+        std::string result(str);
+        std::transform(result.begin(), result.end(), result.begin(), [](unsigned char c) { return std::tolower(c); });
+        return result;
+    }
+
+    std::string_view Trim(std::string_view str) {
+        const auto first = str.find_first_not_of(" \t\r\n");
+        if (first == std::string_view::npos) {
+            return {};
+        }
+        const auto last = str.find_last_not_of(" \t\r\n");
+        return str.substr(first, last - first + 1);
+    }
+
+    bool ParseValue(const std::string& value, bool& result) {
+        if (value == "1" || value == "true") {
+            result = true;
+        } else if (value == "0" || value == "false") {
+            result = false;
+        } else {
+            return false;
+        }
+        return true;
+    }
+
+    // Only the finite values are accepted: the settings end up converted to integer sizes.
+    bool ParseValue(const std::string& value, double& result) {
+        char* end = nullptr;
+        result = strtod(value.c_str(), &end);
+        return !value.empty() && !*end && std::isfinite(result);
+    }
+
+    // Only the decimal digits are accepted (strtoul() also takes a sign, and wraps the negative values around), up to
+    // the range of the signed sizes.
+    bool ParseValue(const std::string& value, uint32_t& result) {
+        if (value.empty() || !std::isdigit(static_cast<unsigned char>(value[0]))) {
+            return false;
+        }
+        char* end = nullptr;
+        const unsigned long long parsed = strtoull(value.c_str(), &end, 10);
+        if (*end || parsed > static_cast<unsigned long long>(std::numeric_limits<int32_t>::max())) {
+            return false;
+        }
+        result = static_cast<uint32_t>(parsed);
+        return true;
+    }
+
+    bool ApplyValue(Config& config, std::string_view key, const std::string& value) {
+        if (key == "foveation") {
+            if (value == "fixed") {
+                config.useFoveatedTangents = false;
+                config.useFoveatedGaze = false;
+            } else if (value == "dynamic") {
+                config.useFoveatedTangents = true;
+                config.useFoveatedGaze = false;
+            } else if (value == "gaze") {
+                config.useFoveatedTangents = true;
+                config.useFoveatedGaze = true;
+            } else {
+                return false;
+            }
+            return true;
+        } else if (key == "foveated_tangents") {
+            return ParseValue(value, config.useFoveatedTangents);
+        } else if (key == "foveated_gaze") {
+            return ParseValue(value, config.useFoveatedGaze);
+        } else if (key == "ppd_scale") {
+            double ppdScale;
+            if (!ParseValue(value, ppdScale) || ppdScale <= 0 || ppdScale > MaxPpdScale) {
+                return false;
+            }
+            config.sizing.ppdScale = ppdScale;
+            return true;
+        } else if (key == "fov_crop") {
+            double fovCrop;
+            if (!ParseValue(value, fovCrop) || fovCrop < 0 || fovCrop >= 1) {
+                return false;
+            }
+            config.sizing.fovCrop = fovCrop;
+            return true;
+        } else if (key == "alignment") {
+            uint32_t alignment;
+            if (!ParseValue(value, alignment) || !IsValidAlignment(alignment)) {
+                return false;
+            }
+            config.sizing.alignment = alignment;
+            return true;
+        } else if (key == "gaze_predictor") {
+            if (value == "none") {
+                config.gazePredictor = gaze::PredictorType::None;
+            } else if (value == "linear") {
+                config.gazePredictor = gaze::PredictorType::ConstantVelocity;
+            } else if (value == "kalman") {
+                config.gazePredictor = gaze::PredictorType::Kalman;
+            } else {
+                return false;
+            }
+            return true;
+        } else if (key == "gaze_latency_ms") {
+            double gazeLatencyMs;
+            if (!ParseValue(value, gazeLatencyMs) || gazeLatencyMs < 0) {
+                return false;
+            }
+            config.gazeLatencyMs = gazeLatencyMs;
+            return true;
+        } else if (key == "gaze_dead_zone") {
+            double gazeDeadZone;
+            if (!ParseValue(value, gazeDeadZone) || gazeDeadZone < 0) {
+                return false;
+            }
+            config.gazeDeadZone = gazeDeadZone;
+            return true;
+        } else if (key == "gaze_blend_ms") {
+            double gazeBlendMs;
+            if (!ParseValue(value, gazeBlendMs) || gazeBlendMs < 0) {
+                return false;
+            }
+            config.gazeBlendMs = gazeBlendMs;
+            return true;
+        } else if (key == "foveation_hints") {
+            varjo_FoveatedFovTangents_Hints hints{};
+            if (!ParseFoveationHints(value, hints)) {
+                return false;
+            }
+            config.foveationHints = hints;
+            return true;
+        } else if (key == "trace_verbose") {
+            return ParseValue(value, config.traceVerbose);
+        } else if (key == "gaze_trace") {
+            config.gazeTrace = value;
+            return true;
+        } else if (key == "synthesize_focus_views") {
+            return ParseValue(value, config.synthesizeFocusViews);
+        } else if (key == "control_channel") {
+            return ParseValue(value, config.controlChannel);
+        } else if (key == "share_geometry") {
+            return ParseValue(value, config.shareGeometry);
+        }
+        return false;
+    }
+
+    void ApplyEntries(Config& config, const Entries& entries) {
+        for (const auto& [key, value] : entries) {
+            if (!ApplyValue(config, key, value)) {
+                TraceLoggingWrite(g_traceProvider,
+                                  "Config_InvalidValue",
+                                  TLArg(key.c_str(), "Key"),
+                                  TLArg(value.c_str(), "Value"));
+            }
+        }
+    }
+
+    void Publish(std::unique_ptr<const Config> newConfig) {
+        const std::shared_ptr<const Config> config(std::move(newConfig));
+        std::atomic_store_explicit(&g_currentConfig, config, std::memory_order_release);
+
+        TraceLoggingWrite(g_traceProvider,
+                          "Config",
+                          TLArg(config->profile.c_str(), "Profile"),
+                          TLArg(config->useFoveatedTangents, "UseFoveatedTangents"),
+                          TLArg(config->useFoveatedGaze, "UseFoveatedGaze"),
+                          TLArg(static_cast<int>(config->gazePredictor), "GazePredictor"),
+                          TLArg(config->gazeLatencyMs, "GazeLatencyMs"),
+                          TLArg(config->gazeDeadZone, "GazeDeadZone"),
+                          TLArg(config->gazeBlendMs, "GazeBlendMs"),
+                          TLArg(FormatFoveationHints(config->foveationHints).c_str(), "FoveationHints"),
+                          TLArg(config->sizing.ppdScale, "PpdScale"),
+                          TLArg(config->sizing.fovCrop, "FovCrop"),
+                          TLArg(config->sizing.alignment, "Alignment"),
+                          TLArg(config->traceVerbose, "TraceVerbose"));
+    }
+
+    void Load(const std::filesystem::path& path, const std::string& executableName) {
+        std::ifstream file(path);
+        if (!file.is_open()) {
+            return;
+        }
+
+        auto config = std::make_unique<Config>(ParseConfig(file, executableName));
+
+        std::unique_lock lock(g_publishMutex);
+        ApplyEntries(*config, g_overrides);
+        Publish(std::move(config));
+    }
+
+    std::filesystem::file_time_type GetLastWriteTime(const std::filesystem::path& path) {
+        std::error_code ec;
+        const auto lastWriteTime = std::filesystem::last_write_time(path, ec);
+        return ec ? std::filesystem::file_time_type::min() : lastWriteTime;
+    }
+
+} // namespace
+
+namespace quadinator::config {
+
+    Config ParseConfig(std::istream& stream, std::string_view executableName) {
+        // Gather the global entries and the profiles, keyed by lower-case executable name.
+        Entries globalEntries;
+        std::unordered_map<std::string, Entries> profiles;
+        Entries* section = &globalEntries;
+
+        std::string line;
+        while (std::getline(stream, line)) {
+            std::string_view entry(line);
+            entry = Trim(entry.substr(0, entry.find('#')));
+            if (entry.empty()) {
+                continue;
+            }
+
+            if (entry.front() == '[' && entry.back() == ']') {
+                section = &profiles[ToLower(Trim(entry.substr(1, entry.size() - 2)))];
+                continue;
+            }
+
+            const auto equal = entry.find('=');
+            if (equal == std::string_view::npos) {
+                TraceLoggingWrite(g_traceProvider, "Config_InvalidEntry", TLArg(line.c_str(), "Entry"));
+                continue;
+            }
+            section->emplace_back(Trim(entry.substr(0, equal)), Trim(entry.substr(equal + 1)));
+        }
+
+        Config config;
+        ApplyEntries(config, globalEntries);
+        const auto it = profiles.find(ToLower(executableName));
+        if (it != profiles.cend()) {
+            config.profile = it->first;
+            ApplyEntries(config, it->second);
+        }
+        return config;
+    }
+
+    void Initialize(const std::filesystem::path& path, std::string_view executableName) {
+        TraceLoggingWrite(g_traceProvider,
+                          "Config_Initialize",
+                          TLArg(path.c_str(), "Path"),
+                          TLArg(std::string(executableName).c_str(), "Executable"));
+
+        auto lastWriteTime = GetLastWriteTime(path);
+        Load(path, std::string(executableName));
+
+        // The watcher runs until the process exits.
+        std::thread([path, executableName = std::string(executableName), lastWriteTime]() mutable {
+            while (true) {
+                std::this_thread::sleep_for(WatchInterval);
+
+                const auto writeTime = GetLastWriteTime(path);
+                if (writeTime != lastWriteTime) {
+                    lastWriteTime = writeTime;
+                    Load(path, executableName);
+                }
+            }
+        }).detach();
+    }
+
+    bool ParseFoveationHints(const std::string& value, varjo_FoveatedFovTangents_Hints& hints) {
+        std::string_view remaining(value);
+        while (!remaining.empty()) {
+            const auto comma = remaining.find(',');
+            const std::string entry(Trim(remaining.substr(0, comma)));
+            remaining = comma == std::string_view::npos ? std::string_view() : remaining.substr(comma + 1);
+
+            const auto colon = entry.find(':');
+            if (colon == std::string::npos) {
+                return false;
+            }
+            uint32_t index;
+            char* end = nullptr;
+            const int64_t word = strtoll(entry.c_str() + colon + 1, &end, 0);
+            if (!ParseValue(std::string(Trim(entry.substr(0, colon))), index) || index >= std::size(hints.reserved) ||
+                end == entry.c_str() + colon + 1 || *end) {
+                return false;
+            }
+            hints.reserved[index] = word;
+        }
+        return true;
+    }
+
+    std::string FormatFoveationHints(const varjo_FoveatedFovTangents_Hints& hints) {
+        std::string result;
+        for (size_t i = 0; i < std::size(hints.reserved); i++) {
+            if (hints.reserved[i]) {
+                result += (result.empty() ? "" : ",") + std::to_string(i) + ":" + std::to_string(hints.reserved[i]);
+            }
+        }
+        return result;
+    }
+
+    bool IsLiveSetting(std::string_view key) {
+        return key == "gaze_predictor" || key == "gaze_latency_ms" || key == "gaze_dead_zone" ||
+               key == "gaze_blend_ms" || key == "fov_crop" || key == "trace_verbose";
+    }
+
+    bool Set(std::string_view key, const std::string& value) {
+        std::unique_lock lock(g_publishMutex);
+        auto config = std::make_unique<Config>(*Current());
+        if (!ApplyValue(*config, key, value)) {
+            return false;
+        }
+
+        // Only the last value of a setting is kept.
+        const auto it = std::find_if(
+            g_overrides.begin(), g_overrides.end(), [&](const auto& entry) { return entry.first == key; });
+        if (it != g_overrides.end()) {
+            it->second = value;
+        } else {
+            g_overrides.emplace_back(key, value);
+        }
+        Publish(std::move(config));
+        return true;
+    }
+
+    std::shared_ptr<const Config> Current() {
+        return std::atomic_load_explicit(&g_currentConfig, std::memory_order_acquire);
+    }
+
+} // namespace quadinator::config
@@ -0,0 +1,111 @@
+// MIT License
+//
+// Copyright(c) 2023 Matthieu Bucchianeri
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this softwareand associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright noticeand this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <filesystem>
+#include <istream>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include "gaze.h"
+#include "geometry.h"
+
+namespace quadinator::config {
+
+    // The configuration file, located next to the DLL.
+    constexpr const char* ConfigFileName = "Quadinator.cfg";
+
+    // An immutable snapshot of the configuration, resolved for the current application.
+    struct Config {
+        // The per-application profile applied on top of the global settings, if any.
+        std::string profile;
+
+        // Use the dynamic foveation tangents (instead of the fixed quad views tangents).
+        bool useFoveatedTangents{true};
+
+        // Use the eye tracker gaze (instead of a forward gaze) for the foveation tangents.
+        bool useFoveatedGaze{false};
+
+        // Extrapolation of the eye tracker gaze to the display time of the frame.
+        gaze::PredictorType gazePredictor{gaze::PredictorType::ConstantVelocity};
+
+        // Gaze-to-display latency to predict for, when the runtime does not report the display time.
+        double gazeLatencyMs{0.0};
+
+        // Angle (degrees) the gaze must move during a fixation before the focus follows it.
+        double gazeDeadZone{1.0};
+
+        // Duration of the transition between the eye tracker gaze and the forward gaze when the tracking is lost or
+        // recovered.
+        double gazeBlendMs{200.0};
+
+        // Hints passed to varjo_GetFoveatedFovTangents(). The SDK only declares reserved words, exposed as is.
+        varjo_FoveatedFovTangents_Hints foveationHints{};
+
+        SizingSettings sizing;
+
+        // Expand the stereo layers (2 views) to the quad views, with focus views carved out of the stereo views.
+        bool synthesizeFocusViews{false};
+
+        // Emit the per-layer and per-view trace events.
+        bool traceVerbose{true};
+
+        // Record the eye tracker samples to this file (relative to the DLL folder), when the gaze is used. Only read
+        // when the eye tracker is first used.
+        std::string gazeTrace;
+
+        // Open the local control channel (only read at startup).
+        bool controlChannel{false};
+
+        // Share the geometry resolved from the runtime with the other processes that load the DLL (only read at
+        // startup).
+        bool shareGeometry{true};
+    };
+
+    // Parse the configuration file contents on top of the defaults. Invalid entries are ignored.
+    // Entries under an [<executable>] section form a per-application profile, that is applied on top of the global
+    // entries when the executable name matches (case-insensitive).
+    Config ParseConfig(std::istream& stream, std::string_view executableName);
+
+    // Load the configuration file and start watching it for changes.
+    void Initialize(const std::filesystem::path& path, std::string_view executableName);
+
+    // Parse hints in the form "<index>:<value>[,<index>:<value>...]" on top of the given hints.
+    bool ParseFoveationHints(const std::string& value, varjo_FoveatedFovTangents_Hints& hints);
+
+    // Inverse of ParseFoveationHints(), listing the non-zero words only.
+    std::string FormatFoveationHints(const varjo_FoveatedFovTangents_Hints& hints);
+
+    // Whether a setting can be changed while a session is running (does not affect the texture sizes).
+    bool IsLiveSetting(std::string_view key);
+
+    // Publish a new snapshot with one setting changed. Returns false if the value is invalid. The change overrides the
+    // configuration file, including after it is reloaded.
+    bool Set(std::string_view key, const std::string& value);
+
+    // The latest configuration snapshot, kept alive for as long as the caller holds it (eg: for a whole frame). Safe
+    // to call from any thread.
+    std::shared_ptr<const Config> Current();
+
+} // namespace quadinator::config
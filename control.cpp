@@ -0,0 +1,227 @@
+// MIT License
+//
+// Copyright(c) 2023 Matthieu Bucchianeri
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this softwareand associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright noticeand this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#include <cstdio>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "config.h"
+#include "control.h"
+#include "stats.h"
+#include "tracing.h"
+
+namespace {
+
+    using namespace quadinator;
+
+    // Requests are short commands.
+    constexpr size_t MaxRequestSize = 1024;
+
+    struct RegisteredCommand {
+        std::string name;
+        std::string help;
+        control::CommandHandler handler;
+    };
+
+    // Only modified before the control channel starts.
+    std::vector<RegisteredCommand> g_registeredCommands;
+
+    std::string DescribeConfig(const config::Config& config) {
+        char buf[2048];
+        snprintf(buf,
+                 sizeof(buf),
+                 "profile=%s\nfoveated_tangents=%d\nfoveated_gaze=%d\ngaze_predictor=%s\ngaze_latency_ms=%.1f\n"
+                 "gaze_dead_zone=%.2f\ngaze_blend_ms=%.0f\n"
+                 "foveation_hints=%s\nppd_scale=%.3f\nfov_crop=%.3f\nalignment=%u\nsynthesize_focus_views=%d\n"
+                 "trace_verbose=%d\n",
+                 config.profile.c_str(),
+                 config.useFoveatedTangents,
+                 config.useFoveatedGaze,
+                 config.gazePredictor == gaze::PredictorType::None               ? "none"
+                 : config.gazePredictor == gaze::PredictorType::ConstantVelocity ? "linear"
+                                                                                 : "kalman",
+                 config.gazeLatencyMs,
+                 config.gazeDeadZone,
+                 config.gazeBlendMs,
+                 config::FormatFoveationHints(config.foveationHints).c_str(),
+                 config.sizing.ppdScale,
+                 config.sizing.fovCrop,
+                 config.sizing.alignment,
+                 config.synthesizeFocusViews,
+                 config.traceVerbose);
+        return buf;
+    }
+
+#ifdef _WIN32
+    void ServiceEndpoint(const std::string& name) {
+        while (true) {
+            HANDLE pipe = CreateNamedPipeA(name.c_str(),
+                                           PIPE_ACCESS_DUPLEX,
+                                           PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS,
+                                           1,
+                                           4096,
+                                           4096,
+                                           0,
+                                           nullptr);
+            if (pipe == INVALID_HANDLE_VALUE) {
+                TraceLoggingWrite(g_traceProvider, "Control_Error", TLArg(GetLastError(), "Error"));
+                return;
+            }
+
+            if (ConnectNamedPipe(pipe, nullptr) || GetLastError() == ERROR_PIPE_CONNECTED) {
+                std::string request;
+                char buf[256];
+                DWORD bytesRead;
+                while (request.find('\n') == std::string::npos && request.size() < MaxRequestSize &&
+                       ReadFile(pipe, buf, sizeof(buf), &bytesRead, nullptr) && bytesRead) {
+                    request.append(buf, bytesRead);
+                }
+
+                const std::string response = control::HandleCommand(request);
+                DWORD bytesWritten;
+                WriteFile(pipe, response.data(), static_cast<DWORD>(response.size()), &bytesWritten, nullptr);
+                FlushFileBuffers(pipe);
+            }
+            DisconnectNamedPipe(pipe);
+            CloseHandle(pipe);
+        }
+    }
+#else
+    void ServiceEndpoint(const std::string& name) {
+        const int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        snprintf(address.sun_path, sizeof(address.sun_path), "%s", name.c_str());
+        unlink(name.c_str());
+        if (listener < 0 || bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) ||
+            listen(listener, 4)) {
+            TraceLoggingWrite(g_traceProvider, "Control_Error");
+            if (listener >= 0) {
+                close(listener);
+            }
+            return;
+        }
+
+        while (true) {
+            const int client = accept(listener, nullptr, nullptr);
+            if (client < 0) {
+                continue;
+            }
+
+            std::string request;
+            char buf[256];
+            ssize_t bytesRead;
+            while (request.find('\n') == std::string::npos && request.size() < MaxRequestSize &&
+                   (bytesRead = read(client, buf, sizeof(buf))) > 0) {
+                request.append(buf, bytesRead);
+            }
+
+            const std::string response = control::HandleCommand(request);
+            for (size_t written = 0; written < response.size();) {
+                const ssize_t bytesWritten = write(client, response.data() + written, response.size() - written);
+                if (bytesWritten <= 0) {
+                    break;
+                }
+                written += bytesWritten;
+            }
+            close(client);
+        }
+    }
+#endif
+
+} // namespace
+
+namespace quadinator::control {
+
+    std::string HandleCommand(std::string_view command) {
+        std::istringstream stream{std::string(command)};
+        std::vector<std::string> args;
+        for (std::string arg; stream >> arg;) {
+            args.push_back(arg);
+        }
+
+        TraceLoggingWrite(g_traceProvider, "Control_Command", TLArg(std::string(command).c_str(), "Command"));
+
+        if (args.empty() || args[0] == "help") {
+            std::string help = "Commands:\n"
+                               "  stats              Show the live statistics\n"
+                               "  reset              Reset the hook latency statistics\n"
+                               "  config             Show the current configuration\n"
+                               "  set <key> <value>  Change a setting that does not require a new session\n";
+            for (const auto& command : g_registeredCommands) {
+                help += "  " + command.help + "\n";
+            }
+            return help;
+        } else if (args[0] == "stats" && args.size() == 1) {
+            return stats::Format();
+        } else if (args[0] == "reset" && args.size() == 1) {
+            stats::Reset();
+            return "ok\n";
+        } else if (args[0] == "config" && args.size() == 1) {
+            return DescribeConfig(*config::Current());
+        } else if (args[0] == "set" && args.size() == 3) {
+            if (!config::IsLiveSetting(args[1])) {
+                return "error: " + args[1] + " cannot be changed live\n";
+            }
+            if (!config::Set(args[1], args[2])) {
+                return "error: invalid value\n";
+            }
+            return "ok\n";
+        }
+
+        for (const auto& registered : g_registeredCommands) {
+            if (args[0] == registered.name) {
+                return registered.handler({args.begin() + 1, args.end()});
+            }
+        }
+        return "error: unknown command\n";
+    }
+
+    void RegisterCommand(const std::string& name, const std::string& help, CommandHandler handler) {
+        g_registeredCommands.push_back({name, help, std::move(handler)});
+    }
+
+    void Start() {
+#ifdef _WIN32
+        const std::string name = GetEndpointName(GetCurrentProcessId());
+#else
+        const std::string name = GetEndpointName(getpid());
+#endif
+        TraceLoggingWrite(g_traceProvider, "Control_Start", TLArg(name.c_str(), "Name"));
+
+        // The control channel is serviced until the process exits.
+        std::thread([name]() { ServiceEndpoint(name); }).detach();
+    }
+
+} // namespace quadinator::control
@@ -0,0 +1,56 @@
+// MIT License
+//
+// Copyright(c) 2023 Matthieu Bucchianeri
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this softwareand associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright noticeand this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace quadinator::control {
+
+    // The local control channel: a named pipe (or a Unix socket on other platforms), serviced on its own thread.
+    // The protocol is one text command per connection, terminated by a newline. The response is sent back before the
+    // connection is closed.
+
+    inline std::string GetEndpointName(uint32_t processId) {
+#ifdef _WIN32
+        return "\\\\.\\pipe\\Quadinator-" + std::to_string(processId);
+#else
+        return "/tmp/quadinator-" + std::to_string(processId) + ".sock";
+#endif
+    }
+
+    std::string HandleCommand(std::string_view command);
+
+    // Handler for a command implemented outside of the control channel. Receives the arguments after the command name.
+    using CommandHandler = std::function<std::string(const std::vector<std::string>& args)>;
+
+    // Register an additional command. Must be called before Start().
+    void RegisterCommand(const std::string& name, const std::string& help, CommandHandler handler);
+
+    // Start servicing the control channel for the current process.
+    void Start();
+
+} // namespace quadinator::control
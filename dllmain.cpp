@@ -24,411 +24,153 @@
 #include <assert.h>
 #define WIN32_LEAN_AND_MEAN
 #include <windows.h>
-#include <detours.h>
-#include <traceloggingactivity.h>
-#include <traceloggingprovider.h>
 
-#include <array>
-#include <cmath>
 #include <filesystem>
-#include <vector>
+#include <iterator>
+#include <string>
+#include <string_view>
 
-#include <Varjo.h>
-#include <Varjo_layers.h>
-#include <Varjo_math.h>
+#include "hooks.h"
+#include "interpose.h"
+#include "tracing.h"
 
 /////////////////////////////////////////////////////////////////////////////
 // Install this DLL into the Varjo OpenXR runtime:
 //   setdll.exe /d:Quadinator.dll VarjoLib.dll
 
-#define USE_FOVEATED_TANGENTS 1
-#define USE_FOVEATED_GAZE 0
-
 #pragma region "Tracelogging"
 
 // {cbf3adcd-42b1-4c38-830b-95980af201f6}
 TRACELOGGING_DEFINE_PROVIDER(g_traceProvider,
                              "Quadinator",
                              (0xcbf3adcd, 0x42b1, 0x4e38, 0x93, 0x0b, 0x95, 0x98, 0x0a, 0xf2, 0x01, 0xf6));
-
-#define IsTraceEnabled() TraceLoggingProviderEnabled(g_traceProvider, 0, 0)
-#define TraceLocalActivity(activity) TraceLoggingActivity<g_traceProvider> activity;
-#define TLArg(var, ...) TraceLoggingValue(var, ##__VA_ARGS__)
-#define TLPArg(var, ...) TraceLoggingPointer(var, ##__VA_ARGS__)
-#pragma endregion
-
-#pragma region "Detours"
-template <typename TMethod>
-void DetourDllAttach(HMODULE dll, const char* target, TMethod hooked, TMethod& original) {
-    if (original) {
-        // Already hooked.
-        return;
-    }
-
-    DetourTransactionBegin();
-    DetourUpdateThread(GetCurrentThread());
-    original = (TMethod)GetProcAddress(dll, target);
-    assert(original);
-    DetourAttach((PVOID*)&original, hooked);
-    DetourTransactionCommit();
-}
 #pragma endregion
 
-template <uint32_t alignment>
-inline constexpr uint32_t AlignTo(uint32_t n) {
-    static_assert((alignment & (alignment - 1)) == 0); // must be power-of-two
-    return (n + alignment - 1) & ~(alignment - 1);
-}
-
-/////////////////////////////////////////////////////////////////////////////
-// Begin, Fun.
-
 namespace {
 
-    // clang-format off
-    struct varjo_AlignedView (*original_GetAlignedView)(double* projectionMatrix) = nullptr;
-    struct varjo_FovTangents (*original_GetFovTangents)(struct varjo_Session* session,
-                                                        int32_t viewIndex) = nullptr;
-    struct varjo_FovTangents (*original_GetFoveatedFovTangents)(struct varjo_Session* session,
-                                                                int32_t indexView,
-                                                                struct varjo_Gaze* gaze,
-                                                                struct varjo_FoveatedFovTangents_Hints* hints) = nullptr;
-    varjo_Bool (*original_GetRenderingGaze)(struct varjo_Session* session,
-                                            struct varjo_Gaze* gaze) = nullptr;
-    struct varjo_Matrix (*original_GetProjectionMatrix)(struct varjo_FovTangents* tangents) = nullptr;
-    // clang-format on
+    using namespace quadinator;
 
-    varjo_Bool GetRenderingGaze(struct varjo_Session* session, struct varjo_Gaze* gaze) {
-#if USE_FOVEATED_GAZE == 1
-        return original_GetRenderingGaze(session, gaze);
-#else
-        *gaze = {};
-        gaze->leftEye.forward[2] = gaze->rightEye.forward[2] = gaze->gaze.forward[2] = 1.0;
-        // gaze->leftPupilSize = gaze->rightPupilSize = 0.5;
-        gaze->leftStatus = gaze->rightStatus = 3;
-        gaze->stability = 1.0;
-        gaze->status = 2;
-        return true;
-#endif
-    }
+    // The Varjo library module that was hooked, pinned upon the deferred initialization.
+    HMODULE g_varjoLib = nullptr;
 
-    struct varjo_FovTangents GetFovTangents(struct varjo_Session* session, int32_t viewIndex) {
-        varjo_Gaze gaze{};
-        if (USE_FOVEATED_TANGENTS && GetRenderingGaze(session, &gaze)) {
-            varjo_FoveatedFovTangents_Hints hints{};
-            return original_GetFoveatedFovTangents(session, viewIndex, &gaze, &hints);
-        } else {
-            return original_GetFovTangents(session, viewIndex);
+    bool IsVrServer() {
+        wchar_t path[_MAX_PATH];
+        if (!GetModuleFileNameW(nullptr, path, static_cast<DWORD>(std::size(path)))) {
+            return false;
         }
+        const wchar_t* name = wcsrchr(path, L'\\');
+        return name && !_wcsicmp(name + 1, L"vrserver.exe");
     }
 
-    void (*original_GetTextureSize)(struct varjo_Session* session,
-                                    varjo_TextureSize_Type type,
-                                    int32_t viewIndex,
-                                    int32_t* width,
-                                    int32_t* height) = nullptr;
-    void hooked_GetTextureSize(struct varjo_Session* session,
-                               varjo_TextureSize_Type type,
-                               int32_t viewIndex,
-                               int32_t* width,
-                               int32_t* height) {
-        TraceLocalActivity(local);
-        TraceLoggingWriteStart(local,
-                               "varjo_GetTextureSize",
-                               TLPArg(session, "Session"),
-                               TLArg(type, "TextureSize_Type"),
-                               TLArg(viewIndex, "ViewIndex"));
-
-        if (type == varjo_TextureSize_Type_Stereo) {
-            // Query the focus view resolution.
-            original_GetTextureSize(session,
-                                    USE_FOVEATED_TANGENTS ? varjo_TextureSize_Type_DynamicFoveation
-                                                          : varjo_TextureSize_Type_Quad,
-                                    2 + viewIndex,
-                                    width,
-                                    height);
-
-            const auto fullFovTangents = GetFovTangents(session, viewIndex);
-            const auto focusFovTangents = GetFovTangents(session, 2 + viewIndex);
-            TraceLoggingWriteTagged(local,
-                                    "varjo_GetTextureSize_FullFov",
-                                    TLArg(viewIndex, "ViewIndex"),
-                                    TLArg(atan(fullFovTangents.bottom), "Bottom"),
-                                    TLArg(atan(fullFovTangents.top), "Top"),
-                                    TLArg(atan(fullFovTangents.left), "Left"),
-                                    TLArg(atan(fullFovTangents.right), "Right"));
-            TraceLoggingWriteTagged(local,
-                                    "varjo_GetTextureSize_FocusFov",
-                                    TLArg(viewIndex, "ViewIndex"),
-                                    TLArg(atan(focusFovTangents.bottom), "Bottom"),
-                                    TLArg(atan(focusFovTangents.top), "Top"),
-                                    TLArg(atan(focusFovTangents.left), "Left"),
-                                    TLArg(atan(focusFovTangents.right), "Right"));
-
-            // Transpose the resolution to the full FOV while keeping a uniform PPD.
-            const double horizontalMultiplier = std::abs(fullFovTangents.right - fullFovTangents.left) /
-                                                std::abs(focusFovTangents.right - focusFovTangents.left);
-            const double verticalMultiplier = std::abs(fullFovTangents.top - fullFovTangents.bottom) /
-                                              std::abs(focusFovTangents.top - focusFovTangents.bottom);
-            TraceLoggingWriteTagged(local,
-                                    "varjo_GetTextureSize_Multipliers",
-                                    TLArg(viewIndex, "ViewIndex"),
-                                    TLArg(horizontalMultiplier, "HorizontalMultiplier"),
-                                    TLArg(verticalMultiplier, "VerticalMultiplier"));
-            *width = AlignTo<2>(static_cast<int32_t>(*width * horizontalMultiplier));
-            *height = AlignTo<2>(static_cast<int32_t>(*height * verticalMultiplier));
-        } else {
-            original_GetTextureSize(session, type, viewIndex, width, height);
+    // The folder containing Quadinator.dll, without the trailing separator.
+    std::wstring GetDllFolder() {
+        HMODULE module;
+        wchar_t path[_MAX_PATH];
+        if (!GetModuleHandleExW(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS | GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT,
+                                reinterpret_cast<LPCWSTR>(&GetDllFolder),
+                                &module) ||
+            !GetModuleFileNameW(module, path, static_cast<DWORD>(std::size(path)))) {
+            return {};
         }
-
-        TraceLoggingWriteStop(local, "varjo_GetTextureSize", TLArg(*width, "Width"), TLArg(*height, "Height"));
+        const wchar_t* name = wcsrchr(path, L'\\');
+        return name ? std::wstring(path, name - path) : std::wstring();
     }
 
-    struct varjo_ViewDescription (*original_GetViewDescription)(struct varjo_Session* session,
-                                                                int32_t viewIndex) = nullptr;
-    struct varjo_ViewDescription hooked_GetViewDescription(struct varjo_Session* session, int32_t viewIndex) {
-        TraceLocalActivity(local);
-        TraceLoggingWriteStart(
-            local, "varjo_GetViewDescription", TLPArg(session, "Session"), TLArg(viewIndex, "ViewIndex"));
-
-        struct varjo_ViewDescription result = original_GetViewDescription(session, viewIndex);
-        if (viewIndex == 0 || viewIndex == 1) {
-            hooked_GetTextureSize(session, varjo_TextureSize_Type_Stereo, viewIndex, &result.width, &result.height);
+    // The module loaded from the folder, if any. GetModuleHandleExW() only looks up the loaded modules, which is
+    // allowed under the loader lock (the library is pinned upon the deferred initialization).
+    HMODULE FindModule(const std::wstring& folder, const wchar_t* name) {
+        if (folder.empty()) {
+            return nullptr;
         }
-
-        TraceLoggingWriteStop(
-            local, "varjo_GetViewDescription", TLArg(result.width, "Width"), TLArg(result.width, "Height"));
-
-        return result;
+        const std::wstring path = folder + L"\\" + name;
+        HMODULE module = nullptr;
+        GetModuleHandleExW(GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT, path.c_str(), &module);
+        TraceLoggingWrite(g_traceProvider, "InstallHooks_Try", TLArg(path.c_str(), "Path"), TLPArg(module, "Lib"));
+        return module;
     }
 
-    void (*original_EndFrameWithLayers)(struct varjo_Session* session,
-                                        struct varjo_SubmitInfoLayers* submitInfo) = nullptr;
-    void hooked_EndFrameWithLayers(struct varjo_Session* session, struct varjo_SubmitInfoLayers* submitInfo) {
-        TraceLocalActivity(local);
-        TraceLoggingWriteStart(local,
-                               "varjo_EndFrameWithLayers",
-                               TLPArg(session, "Session"),
-                               TLArg(submitInfo->frameNumber, "FrameNumber"),
-                               TLArg(submitInfo->layerCount, "LayerCount"));
-
-        struct varjo_SubmitInfoLayers newSubmitInfo = *submitInfo;
-        std::vector<varjo_LayerHeader*> newLayersPtr;
-
-        std::vector<varjo_LayerMultiProj> projAllocator;
-        projAllocator.reserve(submitInfo->layerCount);
-        std::vector<std::array<varjo_LayerMultiProjView, 4>> viewsAllocator;
-        viewsAllocator.reserve(submitInfo->layerCount);
-
-        for (int32_t i = 0; i < submitInfo->layerCount; i++) {
-            TraceLoggingWriteTagged(
-                local, "varjo_EndFrameWithLayers_Layer", TLArg(submitInfo->layers[i]->type, "Type"));
-            if (submitInfo->layers[i]->type == varjo_LayerMultiProjType) {
-                const varjo_LayerMultiProj* proj = reinterpret_cast<const varjo_LayerMultiProj*>(submitInfo->layers[i]);
-                TraceLoggingWriteTagged(local,
-                                        "varjo_EndFrameWithLayers_MultiProj",
-                                        TLArg(proj->header.flags, "Flags"),
-                                        TLArg(proj->space, "Space"),
-                                        TLArg(proj->viewCount, "ViewCount"));
-
-                for (int32_t j = 0; j < proj->viewCount; j++) {
-                    TraceLoggingWriteTagged(local,
-                                            "varjo_EndFrameWithLayers_MultiProj",
-                                            TLArg(j, "ViewIndex"),
-                                            TLPArg(proj->views[j].viewport.swapChain, "SwapChain"),
-                                            TLArg(proj->views[j].viewport.arrayIndex, "ArrayIndex"),
-                                            TLArg(proj->views[j].viewport.x, "X"),
-                                            TLArg(proj->views[j].viewport.y, "Y"),
-                                            TLArg(proj->views[j].viewport.width, "Width"),
-                                            TLArg(proj->views[j].viewport.height, "Height"));
-
-                    const auto tangents = original_GetAlignedView(proj->views[j].projection.value);
-                    TraceLoggingWriteTagged(local,
-                                            "varjo_EndFrameWithLayers_MultiProj",
-                                            TLArg(j, "ViewIndex"),
-                                            TLArg(-atan(tangents.projectionBottom), "Bottom"),
-                                            TLArg(atan(tangents.projectionTop), "Top"),
-                                            TLArg(-atan(tangents.projectionLeft), "Left"),
-                                            TLArg(atan(tangents.projectionRight), "Right"));
-                }
-
-                // Deep copy the projection and view.
-                projAllocator.push_back(*proj);
-                viewsAllocator.push_back({
-                    proj->views[0],
-                    proj->views[1],
-                    proj->views[2 % proj->viewCount],
-                    proj->views[3 % proj->viewCount],
-                });
-                projAllocator.back().views = viewsAllocator.back().data();
-                newLayersPtr.push_back(reinterpret_cast<varjo_LayerHeader*>(&projAllocator.back()));
-
-                // Patch the focus views.
-                auto& views = viewsAllocator.back();
-                for (int32_t k = 2; k < proj->viewCount; k++) {
-                    auto& focusView = views[k];
-                    const auto& referenceView = views[k % 2];
-
-                    // This seems to be how Varjo SDK accepts stereo input.
-                    if (focusView.viewport.width == 1 && focusView.viewport.height == 1) {
-                        const auto fullFovTangents =
-                            original_GetAlignedView(const_cast<double*>(referenceView.projection.value));
-                        const auto focusFovTangents = GetFovTangents(session, k);
-
-                        // Patch viewport to carve the focus view out of the full view.
-                        focusView.viewport.swapChain = referenceView.viewport.swapChain;
-                        focusView.viewport.arrayIndex = referenceView.viewport.arrayIndex;
-                        const double horizontalFov = fullFovTangents.projectionRight + fullFovTangents.projectionLeft;
-                        const double leftOffset =
-                            (focusFovTangents.left + fullFovTangents.projectionLeft) / horizontalFov;
-                        focusView.viewport.x += static_cast<int32_t>(leftOffset * referenceView.viewport.width);
-                        focusView.viewport.width = AlignTo<2>(static_cast<int32_t>(
-                            (std::abs(focusFovTangents.right - focusFovTangents.left) / horizontalFov) *
-                            referenceView.viewport.width));
-                        const double verticalFov = fullFovTangents.projectionTop + fullFovTangents.projectionBottom;
-                        const double topOffset = (fullFovTangents.projectionTop - focusFovTangents.top) / verticalFov;
-                        focusView.viewport.y += static_cast<int32_t>(topOffset * referenceView.viewport.height);
-                        focusView.viewport.height = AlignTo<2>(static_cast<int32_t>(
-                            (std::abs(focusFovTangents.top - focusFovTangents.bottom) / verticalFov) *
-                            referenceView.viewport.height));
-
-                        TraceLoggingWriteTagged(local,
-                                                "varjo_EndFrameWithLayers_MultiProj_Patched",
-                                                TLArg(k, "ViewIndex"),
-                                                TLPArg(focusView.viewport.swapChain, "SwapChain"),
-                                                TLArg(focusView.viewport.arrayIndex, "ArrayIndex"),
-                                                TLArg(focusView.viewport.x, "X"),
-                                                TLArg(focusView.viewport.y, "Y"),
-                                                TLArg(focusView.viewport.width, "Width"),
-                                                TLArg(focusView.viewport.height, "Height"));
-
-                        // Patch to pass the focus FOV.
-                        focusView.projection =
-                            varjo_GetProjectionMatrix(const_cast<varjo_FovTangents*>(&focusFovTangents));
-
-                        TraceLoggingWriteTagged(local,
-                                                "varjo_EndFrameWithLayers_MultiProj_Patched",
-                                                TLArg(k, "ViewIndex"),
-                                                TLArg(atan(focusFovTangents.bottom), "Bottom"),
-                                                TLArg(atan(focusFovTangents.top), "Top"),
-                                                TLArg(atan(focusFovTangents.left), "Left"),
-                                                TLArg(atan(focusFovTangents.right), "Right"));
-
-#if USE_FOVEATED_TANGENTS
-                        projAllocator.back().header.flags |= varjo_LayerFlag_Foveated;
-#endif
-
-                        // TODO: Strip extensions? Do the same process with depth extension?
-                    }
-                }
-            }
-        }
-        newSubmitInfo.layers = newLayersPtr.data();
-
-        original_EndFrameWithLayers(session, &newSubmitInfo);
-
-        TraceLoggingWriteStop(local, "varjo_EndFrameWithLayers");
-    }
-
-    void InstallHooks() {
+    // Runs upon the first call to a hook, outside of the loader lock.
+    void InitializeProcess() {
         std::filesystem::path dllRoot;
         HMODULE module;
         if (GetModuleHandleExW(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS | GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT,
-                               (LPCWSTR)&InstallHooks,
+                               (LPCWSTR)&InitializeProcess,
                                &module)) {
             wchar_t path[_MAX_PATH];
-            GetModuleFileNameW(module, path, sizeof(path));
+            GetModuleFileNameW(module, path, static_cast<DWORD>(std::size(path)));
             dllRoot = std::filesystem::path(path).parent_path();
         }
 
-        std::filesystem::path varjoHome;
-        varjoHome = std::filesystem::path(getenv("ProgramFiles")) / "Varjo";
-
-        bool isVrServer = false;
+        std::string executableName;
         {
             char path[_MAX_PATH];
             GetModuleFileNameA(nullptr, path, sizeof(path));
             std::string_view fullPath(path);
-            isVrServer = fullPath.rfind("\\vrserver.exe") != std::string::npos;
+            executableName = fullPath.substr(fullPath.rfind('\\') + 1);
         }
-        TraceLoggingWrite(g_traceProvider, "InstallHooks", TLArg(isVrServer, "IsVrServer"));
+        hooks::SetProcessInfo(dllRoot, executableName);
 
-        HMODULE varjoLib;
-        bool isVarjoRuntime = false;
-        GetModuleHandleExW(GET_MODULE_HANDLE_EX_FLAG_PIN, (dllRoot / "VarjoLib.dll").c_str(), &varjoLib);
+        // The hooks must not be unloaded with the library.
+        GetModuleHandleExW(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS | GET_MODULE_HANDLE_EX_FLAG_PIN,
+                           reinterpret_cast<LPCWSTR>(g_varjoLib),
+                           &module);
         TraceLoggingWrite(g_traceProvider,
-                          "InstallHooks_Try",
-                          TLArg((dllRoot / "VarjoLib.dll").c_str(), "Path"),
-                          TLPArg(varjoLib, "Lib"));
+                          "InitializeProcess",
+                          TLArg(dllRoot.c_str(), "DllRoot"),
+                          TLArg(executableName.c_str(), "Executable"));
+    }
+
+    // Only the hooks are installed under the loader lock: the Varjo library is looked up among the loaded modules
+    // (Quadinator is loaded as its import), and the entry points are resolved from its export directory.
+    void InstallHooks() {
+        const bool isVrServer = IsVrServer();
+        const std::wstring dllRoot = GetDllFolder();
+
+        // The library next to Quadinator.dll, that it was installed into.
+        bool isVarjoRuntime = false;
+        HMODULE varjoLib = FindModule(dllRoot, L"VarjoLib.dll");
         if (!varjoLib && isVrServer) {
             isVarjoRuntime = true;
-            GetModuleHandleExW(GET_MODULE_HANDLE_EX_FLAG_PIN, (dllRoot / "VarjoRuntime.dll").c_str(), &varjoLib);
-            TraceLoggingWrite(g_traceProvider,
-                              "InstallHooks_Try",
-                              TLArg((dllRoot / "VarjoRuntime.dll").c_str(), "Path"),
-                              TLPArg(varjoLib, "Lib"));
+            varjoLib = FindModule(dllRoot, L"VarjoRuntime.dll");
         }
 
 #ifdef _DEBUG
         // For convenience, search the Varjo folder in order to allow running Quadinator in-place from VS.
+        wchar_t programFiles[_MAX_PATH];
+        const DWORD length =
+            GetEnvironmentVariableW(L"ProgramFiles", programFiles, static_cast<DWORD>(std::size(programFiles)));
+        const std::wstring varjoHome =
+            length && length < std::size(programFiles) ? std::wstring(programFiles) + L"\\Varjo" : std::wstring();
         if (!varjoLib) {
             isVarjoRuntime = false;
-            GetModuleHandleExW(
-                GET_MODULE_HANDLE_EX_FLAG_PIN, (varjoHome / "varjo-openxr" / "VarjoLib.dll").c_str(), &varjoLib);
-            TraceLoggingWrite(g_traceProvider,
-                              "InstallHooks_Try",
-                              TLArg((varjoHome / "varjo-openxr" / "VarjoLib.dll").c_str(), "Path"),
-                              TLPArg(varjoLib, "Lib"));
+            varjoLib = FindModule(varjoHome.empty() ? varjoHome : varjoHome + L"\\varjo-openxr", L"VarjoLib.dll");
         }
         if (!varjoLib && isVrServer) {
             isVarjoRuntime = true;
-            GetModuleHandleExW(GET_MODULE_HANDLE_EX_FLAG_PIN,
-                               (varjoHome / "varjo-compositor" / "VarjoRuntime.dll").c_str(),
-                               &varjoLib);
-            TraceLoggingWrite(g_traceProvider,
-                              "InstallHooks_Try",
-                              TLArg((varjoHome / "varjo-compositor" / "VarjoRuntime.dll").c_str(), "Path"),
-                              TLPArg(varjoLib, "Lib"));
+            varjoLib =
+                FindModule(varjoHome.empty() ? varjoHome : varjoHome + L"\\varjo-compositor", L"VarjoRuntime.dll");
         }
 #endif
 
-        if (varjoLib) {
-            TraceLoggingWrite(
-                g_traceProvider, "InstallHooks", TLPArg(varjoLib, "Lib"), TLArg(isVarjoRuntime, "IsVarjoRuntime"));
-            // clang-format off
-            original_GetAlignedView = reinterpret_cast<decltype(original_GetAlignedView)>(
-                GetProcAddress(varjoLib,
-                               !isVarjoRuntime ? "varjo_GetAlignedView"
-                                               : "struct_varjo_AlignedViewvarjo_GetAlignedViewdoubleP"));
-            original_GetFovTangents = reinterpret_cast<decltype(original_GetFovTangents)>(
-                GetProcAddress(varjoLib,
-                               !isVarjoRuntime ? "varjo_GetFovTangents"
-                                               : "varjo_FovTangentsvarjo_GetFovTangentsstruct_varjo_SessionPint32_t"));
-            original_GetFoveatedFovTangents = reinterpret_cast<decltype(original_GetFoveatedFovTangents)>(
-                GetProcAddress(varjoLib,
-                               !isVarjoRuntime ? "varjo_GetFoveatedFovTangents"
-                                               : "varjo_FovTangentsvarjo_GetFoveatedFovTangentsstruct_varjo_SessionPint32_tstruct_varjo_GazePstruct_varjo_FoveatedFovTangents_HintsP"));
-            original_GetRenderingGaze = reinterpret_cast<decltype(original_GetRenderingGaze)>(
-                GetProcAddress(varjoLib,
-                               !isVarjoRuntime ? "varjo_GetRenderingGaze"
-                                               : "varjo_Boolvarjo_GetRenderingGazestruct_varjo_SessionPstruct_varjo_GazeP"));
-            DetourDllAttach(varjoLib,
-                            !isVarjoRuntime ? "varjo_GetTextureSize"
-                                            : "voidvarjo_GetTextureSizestruct_varjo_SessionPvarjo_TextureSize_Typeint32_tint32_tPint32_tP",
-                            hooked_GetTextureSize,
-                            original_GetTextureSize);
-            DetourDllAttach(varjoLib,
-                            !isVarjoRuntime ? "varjo_GetViewDescription"
-                                            : "struct_varjo_ViewDescriptionvarjo_GetViewDescriptionstruct_varjo_SessionPint32_t",
-                            hooked_GetViewDescription,
-                            original_GetViewDescription);
-            DetourDllAttach(varjoLib,
-                            !isVarjoRuntime ? "varjo_EndFrameWithLayers"
-                                            : "voidvarjo_EndFrameWithLayersstruct_varjo_SessionPstruct_varjo_SubmitInfoLayersP",
-                            hooked_EndFrameWithLayers,
-                            original_EndFrameWithLayers);
-            // clang-format on
+        // Otherwise, the library loaded from anywhere else.
+        if (!varjoLib) {
+            isVarjoRuntime = false;
+            varjoLib = GetModuleHandleW(L"VarjoLib.dll");
+        }
+        if (!varjoLib && isVrServer) {
+            isVarjoRuntime = true;
+            varjoLib = GetModuleHandleW(L"VarjoRuntime.dll");
         }
+        TraceLoggingWrite(
+            g_traceProvider, "InstallHooks", TLPArg(varjoLib, "Lib"), TLArg(isVarjoRuntime, "IsVarjoRuntime"));
+        if (!varjoLib) {
+            return;
+        }
+
+        g_varjoLib = varjoLib;
+        hooks::SetDeferredInitialization(InitializeProcess);
+        const bool installed = hooks::Attach(varjoLib, isVarjoRuntime);
+        TraceLoggingWrite(g_traceProvider, "InstallHooks_Done", TLArg(installed, "Installed"));
     }
 
 } // namespace
@@ -440,9 +182,11 @@ void __declspec(dllexport) dummy() {
 BOOL APIENTRY DllMain(HMODULE hModule, DWORD ul_reason_for_call, LPVOID lpReserved) {
     switch (ul_reason_for_call) {
     case DLL_PROCESS_ATTACH:
-        DetourRestoreAfterWith();
+        interpose::Initialize();
         TraceLoggingRegister(g_traceProvider);
         TraceLoggingWrite(g_traceProvider, "Hello");
+        // Keep this minimal: we are under the loader lock. See InitializeProcess() and Initialize() in hooks.cpp for
+        // the deferred work.
         InstallHooks();
         break;
 
@@ -0,0 +1,119 @@
+// MIT License
+//
+// Copyright(c) 2023 Matthieu Bucchianeri
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this softwareand associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright noticeand this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <iterator>
+#include <utility>
+
+#include "focusgrid.h"
+
+namespace quadinator {
+
+    FocusGrid::FocusGrid(const Query& query,
+                         const Project& project,
+                         const varjo_FovTangents& fullFovTangents,
+                         double step)
+        : m_step(step), m_columns(static_cast<int>(std::ceil(2 * gaze::GazeRange.yaw / step)) + 1),
+          m_rows(static_cast<int>(std::ceil(2 * gaze::GazeRange.pitch / step)) + 1),
+          m_fullFovTangents(fullFovTangents) {
+        m_nodes.reserve(static_cast<size_t>(m_columns) * m_rows);
+        for (int row = 0; row < m_rows; row++) {
+            for (int column = 0; column < m_columns; column++) {
+                // The last node of each axis may be beyond the range, in which case it is clamped.
+                m_nodes.push_back(query(gaze::ClampToGazeRange(
+                    {-gaze::GazeRange.yaw + column * step, -gaze::GazeRange.pitch + row * step})));
+            }
+        }
+        Derive(project);
+    }
+
+    FocusGrid::FocusGrid(std::vector<varjo_FovTangents> nodes,
+                         const Project& project,
+                         const varjo_FovTangents& fullFovTangents,
+                         double step)
+        : m_step(step), m_columns(static_cast<int>(std::ceil(2 * gaze::GazeRange.yaw / step)) + 1),
+          m_rows(static_cast<int>(std::ceil(2 * gaze::GazeRange.pitch / step)) + 1),
+          m_fullFovTangents(fullFovTangents), m_nodes(std::move(nodes)) {
+        assert(m_nodes.size() == NodeCount(step));
+        Derive(project);
+    }
+
+    void FocusGrid::Derive(const Project& project) {
+        const auto fullFov = AlignedViewFromTangents(m_fullFovTangents);
+        m_fractions.reserve(m_nodes.size());
+        m_projections.reserve(m_nodes.size());
+        for (const auto& tangents : m_nodes) {
+            m_fractions.push_back(ComputeCarveFractions(fullFov, tangents));
+            m_projections.push_back(project(tangents));
+        }
+    }
+
+    size_t FocusGrid::NodeCount(double step) {
+        return (static_cast<size_t>(std::ceil(2 * gaze::GazeRange.yaw / step)) + 1) *
+               (static_cast<size_t>(std::ceil(2 * gaze::GazeRange.pitch / step)) + 1);
+    }
+
+    FocusGrid::Geometry FocusGrid::Lookup(const gaze::GazeAngles& angles) const {
+        const auto clamped = gaze::ClampToGazeRange(angles);
+        const double x = (clamped.yaw + gaze::GazeRange.yaw) / m_step;
+        const double y = (clamped.pitch + gaze::GazeRange.pitch) / m_step;
+        const int column = std::min(static_cast<int>(x), m_columns - 2);
+        const int row = std::min(static_cast<int>(y), m_rows - 2);
+        const double fx = x - column;
+        const double fy = y - row;
+
+        const size_t n00 = static_cast<size_t>(row) * m_columns + column;
+        const size_t n01 = n00 + 1;
+        const size_t n10 = n00 + m_columns;
+        const size_t n11 = n10 + 1;
+        const auto interpolate = [&](double a00, double a01, double a10, double a11) {
+            return (1 - fy) * ((1 - fx) * a00 + fx * a01) + fy * ((1 - fx) * a10 + fx * a11);
+        };
+        const auto interpolateAll = [&](const auto& values, auto field) {
+            return interpolate(field(values[n00]), field(values[n01]), field(values[n10]), field(values[n11]));
+        };
+
+        Geometry result{};
+        result.tangents.left = interpolateAll(m_nodes, [](const auto& n) { return n.left; });
+        result.tangents.right = interpolateAll(m_nodes, [](const auto& n) { return n.right; });
+        result.tangents.top = interpolateAll(m_nodes, [](const auto& n) { return n.top; });
+        result.tangents.bottom = interpolateAll(m_nodes, [](const auto& n) { return n.bottom; });
+        result.fractions.x = interpolateAll(m_fractions, [](const auto& n) { return n.x; });
+        result.fractions.y = interpolateAll(m_fractions, [](const auto& n) { return n.y; });
+        result.fractions.width = interpolateAll(m_fractions, [](const auto& n) { return n.width; });
+        result.fractions.height = interpolateAll(m_fractions, [](const auto& n) { return n.height; });
+        for (size_t i = 0; i < std::size(result.projection.value); i++) {
+            result.projection.value[i] = interpolateAll(m_projections, [i](const auto& n) { return n.value[i]; });
+        }
+        return result;
+    }
+
+    double FocusGrid::Distance(const varjo_FovTangents& a, const varjo_FovTangents& b) {
+        return std::max({std::abs(a.left - b.left),
+                         std::abs(a.right - b.right),
+                         std::abs(a.top - b.top),
+                         std::abs(a.bottom - b.bottom)});
+    }
+
+} // namespace quadinator
@@ -0,0 +1,96 @@
+// MIT License
+//
+// Copyright(c) 2023 Matthieu Bucchianeri
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this softwareand associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright noticeand this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+// Focus geometry precomputed over the gaze range, shared between the DLL hooks and the offline tools.
+// This header must remain portable (no Windows or Detours dependencies).
+
+#include <functional>
+#include <vector>
+
+#include <Varjo_types.h>
+
+#include "gaze.h"
+#include "geometry.h"
+
+namespace quadinator {
+
+    // Step (degrees) of the focus grids. Finer than the bilinear interpolation error of the foveation tangents.
+    constexpr double FocusGridStep = 1.25;
+
+    // A grid of the focus geometry of one focus view, indexed by gaze yaw and pitch over gaze::GazeRange. Each node
+    // holds the focus tangents, the carve out of the full FOV that the grid is built for, and the projection. The grid
+    // is immutable once built, and can be read from any thread.
+    class FocusGrid {
+      public:
+        using Query = std::function<varjo_FovTangents(const gaze::GazeAngles& angles)>;
+        using Project = std::function<varjo_Matrix(const varjo_FovTangents& tangents)>;
+
+        // The focus geometry at one gaze.
+        struct Geometry {
+            varjo_FovTangents tangents;
+            CarveFractions fractions;
+            varjo_Matrix projection;
+        };
+
+        // Query the tangents at each node of the grid, every step degrees.
+        FocusGrid(const Query& query, const Project& project, const varjo_FovTangents& fullFovTangents, double step);
+
+        // Rebuild a grid from the nodes of another grid with the same step. There must be NodeCount(step) nodes.
+        FocusGrid(std::vector<varjo_FovTangents> nodes,
+                  const Project& project,
+                  const varjo_FovTangents& fullFovTangents,
+                  double step);
+
+        static size_t NodeCount(double step);
+
+        // Bilinear interpolation between the nodes around the gaze. The gaze is clamped to the range. The carve
+        // fractions are affine in the tangents, so they match the interpolated tangents (up to the rounding); the
+        // projection is within the interpolation error.
+        Geometry Lookup(const gaze::GazeAngles& angles) const;
+
+        const varjo_FovTangents& fullFovTangents() const {
+            return m_fullFovTangents;
+        }
+
+        const std::vector<varjo_FovTangents>& nodes() const {
+            return m_nodes;
+        }
+
+        // Largest difference between two sets of tangents.
+        static double Distance(const varjo_FovTangents& a, const varjo_FovTangents& b);
+
+      private:
+        // Derive the carve and the projection of each node.
+        void Derive(const Project& project);
+
+        const double m_step;
+        const int m_columns;
+        const int m_rows;
+        const varjo_FovTangents m_fullFovTangents;
+        std::vector<varjo_FovTangents> m_nodes;
+        std::vector<CarveFractions> m_fractions;
+        std::vector<varjo_Matrix> m_projections;
+    };
+
+} // namespace quadinator
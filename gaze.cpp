@@ -0,0 +1,257 @@
+// MIT License
+//
+// Copyright(c) 2023 Matthieu Bucchianeri
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this softwareand associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright noticeand this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <algorithm>
+#include <cmath>
+
+#include "gaze.h"
+
+namespace {
+
+    using namespace quadinator::gaze;
+
+    constexpr double Pi = 3.14159265358979323846;
+    constexpr double DegreesPerRadian = 180.0 / Pi;
+
+    // A gap in the samples longer than this (eg: blink, tracking loss) restarts the estimation.
+    constexpr double MaxSampleGap = 0.1;
+
+    // Upper bound for the eye velocity (peak saccadic velocity), in degrees per second.
+    constexpr double MaxVelocity = 700.0;
+
+    // Smoothing of the velocity estimate for the constant velocity model.
+    constexpr double VelocitySmoothing = 0.5;
+
+    // Kalman filter tuning: measurement noise (degrees^2) and process noise (white acceleration spectral density,
+    // degrees^2/s^3).
+    constexpr double MeasurementNoise = 0.25;
+    constexpr double ProcessNoise = 2.0e5;
+    constexpr double InitialVelocityVariance = 1.0e4;
+
+} // namespace
+
+namespace quadinator::gaze {
+
+    GazeAngles ToAngles(const varjo_Ray& ray) {
+        const double x = ray.forward[0];
+        const double y = ray.forward[1];
+        const double z = ray.forward[2];
+        return {std::atan2(x, z) * DegreesPerRadian, std::atan2(y, std::sqrt(x * x + z * z)) * DegreesPerRadian};
+    }
+
+    void FromAngles(const GazeAngles& angles, varjo_Ray& ray) {
+        const double yaw = angles.yaw / DegreesPerRadian;
+        const double pitch = angles.pitch / DegreesPerRadian;
+        ray.forward[0] = std::sin(yaw) * std::cos(pitch);
+        ray.forward[1] = std::sin(pitch);
+        ray.forward[2] = std::cos(yaw) * std::cos(pitch);
+    }
+
+    double AngularDistance(const GazeAngles& a, const GazeAngles& b) {
+        varjo_Ray rayA{}, rayB{};
+        FromAngles(a, rayA);
+        FromAngles(b, rayB);
+        const double dot =
+            rayA.forward[0] * rayB.forward[0] + rayA.forward[1] * rayB.forward[1] + rayA.forward[2] * rayB.forward[2];
+        return std::acos(std::clamp(dot, -1.0, 1.0)) * DegreesPerRadian;
+    }
+
+    GazeAngles ClampToGazeRange(const GazeAngles& angles) {
+        return {std::clamp(angles.yaw, -GazeRange.yaw, GazeRange.yaw),
+                std::clamp(angles.pitch, -GazeRange.pitch, GazeRange.pitch)};
+    }
+
+    GazePredictor::GazePredictor(PredictorType type) : m_type(type) {
+    }
+
+    void GazePredictor::SetType(PredictorType type) {
+        if (type != m_type) {
+            m_type = type;
+            Reset();
+        }
+    }
+
+    void GazePredictor::Reset() {
+        m_hasSample = false;
+        m_velocity = {};
+    }
+
+    void GazePredictor::Update(int64_t timeNs, const GazeAngles& angles) {
+        const double dt = (timeNs - m_lastTimeNs) / 1e9;
+        if (m_hasSample && dt <= 0) {
+            return;
+        }
+
+        if (!m_hasSample || dt > MaxSampleGap) {
+            m_angles = angles;
+            m_velocity = {};
+            for (auto& covariance : m_covariance) {
+                covariance = {MeasurementNoise, 0, InitialVelocityVariance};
+            }
+        } else if (m_type == PredictorType::Kalman) {
+            UpdateKalman(dt, angles);
+        } else {
+            UpdateConstantVelocity(dt, angles);
+        }
+
+        m_velocity.yaw = std::clamp(m_velocity.yaw, -MaxVelocity, MaxVelocity);
+        m_velocity.pitch = std::clamp(m_velocity.pitch, -MaxVelocity, MaxVelocity);
+        m_lastTimeNs = timeNs;
+        m_hasSample = true;
+    }
+
+    GazeAngles GazePredictor::Predict(int64_t timeNs) const {
+        if (!m_hasSample || m_type == PredictorType::None) {
+            return m_angles;
+        }
+
+        const double horizon = std::clamp(timeNs - m_lastTimeNs, int64_t(0), MaxHorizonNs) / 1e9;
+        return {m_angles.yaw + m_velocity.yaw * horizon, m_angles.pitch + m_velocity.pitch * horizon};
+    }
+
+    void GazePredictor::UpdateConstantVelocity(double dt, const GazeAngles& angles) {
+        const GazeAngles velocity{(angles.yaw - m_angles.yaw) / dt, (angles.pitch - m_angles.pitch) / dt};
+        m_velocity.yaw += VelocitySmoothing * (velocity.yaw - m_velocity.yaw);
+        m_velocity.pitch += VelocitySmoothing * (velocity.pitch - m_velocity.pitch);
+        m_angles = angles;
+    }
+
+    void GazePredictor::UpdateKalman(double dt, const GazeAngles& angles) {
+        double* const state[2][2] = {{&m_angles.yaw, &m_velocity.yaw}, {&m_angles.pitch, &m_velocity.pitch}};
+        const double measurement[2] = {angles.yaw, angles.pitch};
+
+        // Constant velocity model with a white noise acceleration, filtered independently on each axis.
+        for (int axis = 0; axis < 2; axis++) {
+            double& angle = *state[axis][0];
+            double& velocity = *state[axis][1];
+            auto& p = m_covariance[axis];
+
+            // Predict.
+            angle += velocity * dt;
+            const double dt2 = dt * dt;
+            const double p00 = p.p00 + dt * (2 * p.p01 + dt * p.p11) + ProcessNoise * dt2 * dt / 3;
+            const double p01 = p.p01 + dt * p.p11 + ProcessNoise * dt2 / 2;
+            const double p11 = p.p11 + ProcessNoise * dt;
+
+            // Correct.
+            const double innovation = measurement[axis] - angle;
+            const double s = p00 + MeasurementNoise;
+            const double k0 = p00 / s;
+            const double k1 = p01 / s;
+            angle += k0 * innovation;
+            velocity += k1 * innovation;
+            p.p00 = (1 - k0) * p00;
+            p.p01 = (1 - k0) * p01;
+            p.p11 = p11 - k1 * p01;
+        }
+    }
+
+    void GazeStabilizer::Reset() {
+        m_hasSample = false;
+        m_movement = EyeMovement::Fixation;
+        m_moved = false;
+    }
+
+    GazeAngles GazeStabilizer::Update(int64_t timeNs, const GazeAngles& angles, double deadZone) {
+        const double dt = (timeNs - m_lastTimeNs) / 1e9;
+        m_moved = false;
+        if (m_hasSample && dt <= 0) {
+            return m_focus;
+        }
+
+        if (!m_hasSample || dt > MaxSampleGap) {
+            m_movement = EyeMovement::Fixation;
+            m_moved = true;
+        } else {
+            const double velocity = AngularDistance(angles, m_lastAngles) / dt;
+            const EyeMovement previous = m_movement;
+            if (velocity > SaccadeOnsetVelocity) {
+                m_movement = EyeMovement::Saccade;
+            } else if (velocity < SaccadeOffsetVelocity) {
+                m_movement = EyeMovement::Fixation;
+            }
+
+            m_moved = m_movement == EyeMovement::Saccade || previous == EyeMovement::Saccade ||
+                      AngularDistance(angles, m_focus) > deadZone;
+        }
+
+        if (m_moved) {
+            m_focus = angles;
+        }
+        m_lastAngles = angles;
+        m_lastTimeNs = timeNs;
+        m_hasSample = true;
+        return m_focus;
+    }
+
+    double GazeFallback::Update(int64_t timeNs, const varjo_Gaze& gaze, double blendTime) {
+        const bool isValid = gaze.status == 2 /* Valid */ &&
+                             (gaze.leftStatus >= 2 /* Compensated */ || gaze.rightStatus >= 2 /* Compensated */);
+        const bool isGood = isValid && gaze.stability >= StabilityHigh;
+        const bool isBad = !isValid || gaze.stability < StabilityLow;
+        if (isGood) {
+            m_lastGood = gaze;
+        }
+
+        switch (m_state) {
+        case TrackingState::Lost:
+            if (isGood) {
+                m_state = TrackingState::Acquiring;
+                m_stateTimeNs = timeNs;
+            }
+            break;
+
+        case TrackingState::Acquiring:
+            if (isBad) {
+                m_state = TrackingState::Lost;
+            } else if (timeNs - m_stateTimeNs >= AcquireTimeNs) {
+                m_state = TrackingState::Tracking;
+                m_badSinceNs = -1;
+            }
+            break;
+
+        case TrackingState::Tracking:
+            if (!isBad) {
+                m_badSinceNs = -1;
+            } else if (m_badSinceNs < 0) {
+                m_badSinceNs = timeNs;
+            } else if (timeNs - m_badSinceNs >= LoseTimeNs) {
+                m_state = TrackingState::Lost;
+            }
+            break;
+        }
+
+        const double target = m_state == TrackingState::Tracking ? 1.0 : 0.0;
+        const double dt = m_hasUpdate ? std::max(timeNs - m_lastTimeNs, int64_t(0)) / 1e9 : 0.0;
+        if (blendTime <= 0) {
+            m_weight = target;
+        } else if (m_weight < target) {
+            m_weight = std::min(m_weight + dt / blendTime, target);
+        } else {
+            m_weight = std::max(m_weight - dt / blendTime, target);
+        }
+        m_lastTimeNs = timeNs;
+        m_hasUpdate = true;
+        return m_weight;
+    }
+
+} // namespace quadinator::gaze
@@ -0,0 +1,190 @@
+// MIT License
+//
+// Copyright(c) 2023 Matthieu Bucchianeri
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this softwareand associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright noticeand this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+// Gaze processing, shared between the DLL hooks and the offline tools.
+// This header must remain portable (no Windows or Detours dependencies).
+
+#include <cstdint>
+
+#include <Varjo_types.h>
+
+namespace quadinator::gaze {
+
+    // Gaze direction in degrees. Yaw is positive to the right and pitch is positive upward.
+    struct GazeAngles {
+        double yaw;
+        double pitch;
+    };
+
+    GazeAngles ToAngles(const varjo_Ray& ray);
+
+    // Replace the direction of the ray, keeping its origin.
+    void FromAngles(const GazeAngles& angles, varjo_Ray& ray);
+
+    // Angular distance between two directions, in degrees.
+    double AngularDistance(const GazeAngles& a, const GazeAngles& b);
+
+    // Extent of the gaze directions the eye tracker reports, in degrees from forward. The texture sizing covers the
+    // focus positions within this range, and the focus is kept within it.
+    constexpr GazeAngles GazeRange{30.0, 25.0};
+
+    GazeAngles ClampToGazeRange(const GazeAngles& angles);
+
+    enum class PredictorType {
+        None,
+        ConstantVelocity,
+        Kalman,
+    };
+
+    // Extrapolates the gaze direction to a future time (typically the predicted display time of the frame).
+    // Not thread-safe: meant to be updated and queried from the thread submitting the frames.
+    class GazePredictor {
+      public:
+        explicit GazePredictor(PredictorType type = PredictorType::ConstantVelocity);
+
+        PredictorType type() const {
+            return m_type;
+        }
+
+        // Change the model. The estimation restarts when the model changes.
+        void SetType(PredictorType type);
+
+        void Reset();
+
+        // Add a new gaze sample. Samples older than the last one are ignored.
+        void Update(int64_t timeNs, const GazeAngles& angles);
+
+        // Predict the gaze direction at the given time. The horizon is clamped to MaxHorizonNs.
+        GazeAngles Predict(int64_t timeNs) const;
+
+        // Beyond this horizon, the prediction is more harmful than helpful.
+        static constexpr int64_t MaxHorizonNs = 50'000'000;
+
+      private:
+        void UpdateConstantVelocity(double dt, const GazeAngles& angles);
+        void UpdateKalman(double dt, const GazeAngles& angles);
+
+        PredictorType m_type;
+
+        bool m_hasSample{false};
+        int64_t m_lastTimeNs{0};
+        GazeAngles m_angles{};
+
+        // Angular velocity in degrees per second.
+        GazeAngles m_velocity{};
+
+        // Kalman filter covariance, per axis, of the [angle, velocity] state.
+        struct Covariance {
+            double p00, p01, p11;
+        };
+        Covariance m_covariance[2]{};
+    };
+
+    enum class EyeMovement {
+        Fixation,
+        Saccade,
+    };
+
+    // Classifies the eye movement with a velocity threshold (I-VT, with hysteresis) and holds the focus position
+    // during fixations, so that the focus geometry only changes when the gaze moves meaningfully.
+    // Not thread-safe: meant to be updated from the thread submitting the frames.
+    class GazeStabilizer {
+      public:
+        void Reset();
+
+        // Returns the gaze to use for the focus. During a fixation, the focus is held until the gaze leaves the
+        // dead-zone (in degrees) around it. During a saccade and upon its landing, the focus follows the gaze.
+        GazeAngles Update(int64_t timeNs, const GazeAngles& angles, double deadZone);
+
+        EyeMovement movement() const {
+            return m_movement;
+        }
+
+        // Whether the last update moved the focus.
+        bool moved() const {
+            return m_moved;
+        }
+
+        // Velocity thresholds (degrees per second) for entering and leaving a saccade.
+        static constexpr double SaccadeOnsetVelocity = 75.0;
+        static constexpr double SaccadeOffsetVelocity = 40.0;
+
+      private:
+        bool m_hasSample{false};
+        int64_t m_lastTimeNs{0};
+        GazeAngles m_lastAngles{};
+        GazeAngles m_focus{};
+        EyeMovement m_movement{EyeMovement::Fixation};
+        bool m_moved{false};
+    };
+
+    enum class TrackingState {
+        // The gaze is not used, the focus is forward.
+        Lost,
+        // The tracking is good again, but not for long enough to be trusted.
+        Acquiring,
+        Tracking,
+    };
+
+    // Falls back to a forward gaze when the eye tracking is lost (eg: calibration drop-out, headset removed), and
+    // blends back to the tracked gaze once the tracking is stable again. Short drop-outs (blinks) hold the last good
+    // sample instead.
+    // Not thread-safe: meant to be updated from the thread submitting the frames.
+    class GazeFallback {
+      public:
+        // Classify the sample and return the weight of the eye tracker gaze (versus the forward gaze) for this frame.
+        // The weight moves by at most 1 per blendTime (seconds).
+        double Update(int64_t timeNs, const varjo_Gaze& gaze, double blendTime);
+
+        TrackingState state() const {
+            return m_state;
+        }
+
+        // The last sample of good quality. Only meaningful once the weight is not 0.
+        const varjo_Gaze& lastGood() const {
+            return m_lastGood;
+        }
+
+        // A sample is good when it is valid, at least one eye is tracked, and its stability is above the upper bound.
+        // It is bad when it is invalid or its stability is below the lower bound. In between, the state is unchanged.
+        static constexpr double StabilityHigh = 0.75;
+        static constexpr double StabilityLow = 0.5;
+
+        // Time the tracking must be good before it is used again.
+        static constexpr int64_t AcquireTimeNs = 150'000'000;
+
+        // Time the tracking must be bad before falling back. Shorter drop-outs are treated as blinks.
+        static constexpr int64_t LoseTimeNs = 300'000'000;
+
+      private:
+        TrackingState m_state{TrackingState::Lost};
+        bool m_hasUpdate{false};
+        int64_t m_lastTimeNs{0};
+        int64_t m_stateTimeNs{0};
+        int64_t m_badSinceNs{-1};
+        double m_weight{0.0};
+        varjo_Gaze m_lastGood{};
+    };
+
+} // namespace quadinator::gaze
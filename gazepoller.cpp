@@ -0,0 +1,123 @@
+// MIT License
+//
+// Copyright(c) 2023 Matthieu Bucchianeri
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this softwareand associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright noticeand this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <cstring>
+
+#include "gazepoller.h"
+
+namespace quadinator::gaze {
+
+    void GazeRing::Push(const varjo_Gaze& gaze) {
+        uint64_t words[Words]{};
+        std::memcpy(words, &gaze, sizeof(gaze));
+
+        const uint64_t index = m_count.load(std::memory_order_relaxed);
+        Slot& slot = m_slots[index % Capacity];
+
+        slot.sequence.store(2 * index + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        for (size_t i = 0; i < Words; i++) {
+            slot.words[i].store(words[i], std::memory_order_relaxed);
+        }
+        slot.sequence.store(2 * (index + 1), std::memory_order_release);
+
+        m_count.store(index + 1, std::memory_order_release);
+    }
+
+    bool GazeRing::Read(uint64_t index, varjo_Gaze& gaze) const {
+        const Slot& slot = m_slots[index % Capacity];
+        const uint64_t expected = 2 * (index + 1);
+
+        uint64_t words[Words];
+        if (slot.sequence.load(std::memory_order_acquire) != expected) {
+            return false;
+        }
+        for (size_t i = 0; i < Words; i++) {
+            words[i] = slot.words[i].load(std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.sequence.load(std::memory_order_relaxed) != expected) {
+            // Overwritten while reading.
+            return false;
+        }
+
+        std::memcpy(&gaze, words, sizeof(gaze));
+        return true;
+    }
+
+    bool GazeRing::Latest(varjo_Gaze& gaze) const {
+        // The producer can only lap a reader that is preempted for a full ring worth of samples, so retrying on the
+        // new latest sample is bounded in practice.
+        while (true) {
+            const uint64_t count = Count();
+            if (!count) {
+                return false;
+            }
+            if (Read(count - 1, gaze)) {
+                return true;
+            }
+        }
+    }
+
+    void GazePoller::Start(Sampler sampler, Listener listener, std::chrono::microseconds period) {
+        Stop();
+        m_stop.store(false, std::memory_order_relaxed);
+        m_thread = std::thread([this, sampler = std::move(sampler), listener = std::move(listener), period]() {
+            Run(sampler, listener, period);
+        });
+    }
+
+    void GazePoller::Stop() {
+        if (m_thread.joinable()) {
+            m_stop.store(true, std::memory_order_relaxed);
+            m_thread.join();
+        }
+    }
+
+    void GazePoller::Run(const Sampler& sampler, const Listener& listener, std::chrono::microseconds period) {
+        varjo_Nanoseconds lastCaptureTime = 0;
+        auto deadline = std::chrono::steady_clock::now();
+        while (!m_stop.load(std::memory_order_relaxed)) {
+            varjo_Gaze gaze{};
+            if (sampler(&gaze)) {
+                if (gaze.captureTime != lastCaptureTime) {
+                    m_ring.Push(gaze);
+                    lastCaptureTime = gaze.captureTime;
+                    if (listener) {
+                        listener(gaze);
+                    }
+                }
+                m_lastPollTime.store(std::chrono::steady_clock::now().time_since_epoch().count(),
+                                     std::memory_order_release);
+            }
+
+            deadline += period;
+            const auto now = std::chrono::steady_clock::now();
+            if (deadline < now) {
+                // Do not try to catch up after a stall.
+                deadline = now;
+            }
+            std::this_thread::sleep_until(deadline);
+        }
+    }
+
+} // namespace quadinator::gaze
@@ -0,0 +1,118 @@
+// MIT License
+//
+// Copyright(c) 2023 Matthieu Bucchianeri
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this softwareand associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright noticeand this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+// Background sampling of the eye tracker, shared between the DLL hooks and the offline tools.
+// This header must remain portable (no Windows or Detours dependencies).
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <thread>
+
+#include <Varjo_types.h>
+
+namespace quadinator::gaze {
+
+    // Single-producer, multi-consumer ring of gaze samples. The producer never waits for the consumers, and the
+    // consumers never block the producer: each slot is guarded by a sequence number (seqlock), and a consumer that
+    // races with the producer on a slot retries or skips it. The payload is stored as relaxed atomic words, so
+    // concurrent accesses are well-defined.
+    class GazeRing {
+      public:
+        static constexpr uint64_t Capacity = 64;
+
+        // Producer only.
+        void Push(const varjo_Gaze& gaze);
+
+        // Number of samples pushed so far. Sample i is available while Count() - i <= Capacity.
+        uint64_t Count() const {
+            return m_count.load(std::memory_order_acquire);
+        }
+
+        // Read sample i. Returns false if the sample was not pushed yet or was overwritten.
+        bool Read(uint64_t index, varjo_Gaze& gaze) const;
+
+        // Read the most recent sample. Returns false if no sample was pushed yet.
+        bool Latest(varjo_Gaze& gaze) const;
+
+      private:
+        static constexpr size_t Words = (sizeof(varjo_Gaze) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+        struct Slot {
+            // Odd while the slot is being written. Otherwise, 2 * (index + 1) of the sample it holds.
+            std::atomic<uint64_t> sequence{0};
+            std::atomic<uint64_t> words[Words]{};
+        };
+
+        Slot m_slots[Capacity];
+        std::atomic<uint64_t> m_count{0};
+    };
+
+    // Samples the eye tracker on a dedicated thread, so that the frame submission never waits for the runtime.
+    // New samples (by capture time) are pushed to the ring.
+    class GazePoller {
+      public:
+        using Sampler = std::function<bool(varjo_Gaze*)>;
+        using Listener = std::function<void(const varjo_Gaze&)>;
+
+        ~GazePoller() {
+            Stop();
+        }
+
+        // Start polling. Stops the previous polling first, if any. The optional listener is invoked on the polling
+        // thread with each new sample.
+        void Start(Sampler sampler, Listener listener = nullptr, std::chrono::microseconds period = DefaultPeriod);
+
+        // Stop polling and wait for the thread to exit. The ring keeps its samples.
+        void Stop();
+
+        bool IsRunning() const {
+            return m_thread.joinable();
+        }
+
+        const GazeRing& ring() const {
+            return m_ring;
+        }
+
+        // When the eye tracker last answered a poll. The latest sample of the ring is what it reported then, so a
+        // reader can tell a current sample from the one left by a stopped or stalled poller.
+        std::chrono::steady_clock::time_point lastPollTime() const {
+            return std::chrono::steady_clock::time_point(
+                std::chrono::steady_clock::duration(m_lastPollTime.load(std::memory_order_acquire)));
+        }
+
+        // Poll faster than the eye tracker (up to 200Hz), to pick up each sample soon after its capture.
+        static constexpr std::chrono::microseconds DefaultPeriod{2000};
+
+      private:
+        void Run(const Sampler& sampler, const Listener& listener, std::chrono::microseconds period);
+
+        GazeRing m_ring;
+        std::atomic<std::chrono::steady_clock::rep> m_lastPollTime{0};
+        std::thread m_thread;
+        std::atomic<bool> m_stop{false};
+    };
+
+} // namespace quadinator::gaze
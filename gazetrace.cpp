@@ -0,0 +1,235 @@
+// MIT License
+//
+// Copyright(c) 2023 Matthieu Bucchianeri
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this softwareand associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright noticeand this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+#include <string>
+
+#include "gazetrace.h"
+
+namespace {
+
+    using namespace quadinator::gaze;
+
+    void ToFloats(const varjo_Ray& ray, float (&forward)[3]) {
+        for (int i = 0; i < 3; i++) {
+            forward[i] = static_cast<float>(ray.forward[i]);
+        }
+    }
+
+    void FromFloats(const float (&forward)[3], varjo_Ray& ray) {
+        for (int i = 0; i < 3; i++) {
+            ray.forward[i] = forward[i];
+        }
+    }
+
+    bool LoadCsvTrace(std::ifstream& file, std::vector<varjo_Gaze>& samples) {
+        std::string line;
+        while (std::getline(file, line)) {
+            if (line.empty() || line[0] == '#') {
+                continue;
+            }
+            std::replace(line.begin(), line.end(), ',', ' ');
+            std::istringstream fields(line);
+            long long captureTime;
+            varjo_Gaze gaze{};
+            int status = 2;
+            if (!(fields >> captureTime >> gaze.gaze.forward[0] >> gaze.gaze.forward[1] >> gaze.gaze.forward[2])) {
+                return false;
+            }
+            fields >> status;
+            gaze.captureTime = captureTime;
+            gaze.leftEye = gaze.rightEye = gaze.gaze;
+            gaze.status = status;
+            gaze.leftStatus = gaze.rightStatus = status == 2 ? 3 : 0;
+            gaze.stability = status == 2 ? 1.0 : 0.0;
+            gaze.frameNumber = static_cast<int64_t>(samples.size());
+            samples.push_back(gaze);
+        }
+        return !samples.empty();
+    }
+
+    // Minimum-jerk position profile, a good approximation of the saccadic velocity profile.
+    double MinimumJerk(double t) {
+        return t * t * t * (10 - t * (15 - 6 * t));
+    }
+
+} // namespace
+
+namespace quadinator::gaze {
+
+    TraceRecord ToTraceRecord(const varjo_Gaze& gaze) {
+        TraceRecord record{};
+        record.captureTime = gaze.captureTime;
+        record.frameNumber = gaze.frameNumber;
+        ToFloats(gaze.gaze, record.gaze);
+        ToFloats(gaze.leftEye, record.leftEye);
+        ToFloats(gaze.rightEye, record.rightEye);
+        record.focusDistance = static_cast<float>(gaze.focusDistance);
+        record.stability = static_cast<float>(gaze.stability);
+        record.leftPupilSize = static_cast<float>(gaze.leftPupilSize);
+        record.rightPupilSize = static_cast<float>(gaze.rightPupilSize);
+        record.status = static_cast<int8_t>(gaze.status);
+        record.leftStatus = static_cast<int8_t>(gaze.leftStatus);
+        record.rightStatus = static_cast<int8_t>(gaze.rightStatus);
+        return record;
+    }
+
+    varjo_Gaze FromTraceRecord(const TraceRecord& record) {
+        varjo_Gaze gaze{};
+        gaze.captureTime = record.captureTime;
+        gaze.frameNumber = record.frameNumber;
+        FromFloats(record.gaze, gaze.gaze);
+        FromFloats(record.leftEye, gaze.leftEye);
+        FromFloats(record.rightEye, gaze.rightEye);
+        gaze.focusDistance = record.focusDistance;
+        gaze.stability = record.stability;
+        gaze.leftPupilSize = record.leftPupilSize;
+        gaze.rightPupilSize = record.rightPupilSize;
+        gaze.status = record.status;
+        gaze.leftStatus = record.leftStatus;
+        gaze.rightStatus = record.rightStatus;
+        return gaze;
+    }
+
+    bool TraceWriter::Open(const std::filesystem::path& path) {
+        m_file.open(path, std::ios::binary | std::ios::trunc);
+        const TraceHeader header{TraceMagic, TraceVersion, sizeof(TraceRecord), 0};
+        m_file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        return m_file.good();
+    }
+
+    void TraceWriter::Write(const varjo_Gaze& gaze) {
+        const TraceRecord record = ToTraceRecord(gaze);
+        m_file.write(reinterpret_cast<const char*>(&record), sizeof(record));
+    }
+
+    void TraceWriter::Flush() {
+        m_file.flush();
+    }
+
+    void TraceWriter::Close() {
+        m_file.close();
+    }
+
+    bool LoadTrace(const std::filesystem::path& path, std::vector<varjo_Gaze>& samples) {
+        std::ifstream file(path, std::ios::binary);
+        TraceHeader header{};
+        if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) || header.magic != TraceMagic) {
+            file.clear();
+            file.seekg(0);
+            return LoadCsvTrace(file, samples);
+        }
+        if (header.version != TraceVersion || header.recordSize != sizeof(TraceRecord)) {
+            return false;
+        }
+
+        TraceRecord record;
+        while (file.read(reinterpret_cast<char*>(&record), sizeof(record))) {
+            samples.push_back(FromTraceRecord(record));
+        }
+        return !samples.empty();
+    }
+
+    GazeSynthesizer::GazeSynthesizer(uint32_t seed, const SynthesisSettings& settings)
+        : m_settings(settings), m_random(seed) {
+        m_nextBlink = std::exponential_distribution<double>(1.0 / m_settings.blinkInterval)(m_random);
+        m_phaseDuration = m_settings.fixationDuration;
+    }
+
+    GazeAngles GazeSynthesizer::RandomTarget() {
+        // Most fixations are near the center of the field of view.
+        std::normal_distribution<double> yaw(0.0, GazeRange.yaw / 2);
+        std::normal_distribution<double> pitch(0.0, GazeRange.pitch / 2);
+        return ClampToGazeRange({yaw(m_random), pitch(m_random)});
+    }
+
+    void GazeSynthesizer::StartNextMovement() {
+        m_phaseElapsed = 0.0;
+        m_from = m_angles;
+
+        if (m_phase == Phase::Saccade || m_phase == Phase::Pursuit || m_phase == Phase::Blink) {
+            // Every eye movement (or blink) ends in a fixation.
+            m_phase = Phase::Fixation;
+            const double sigma = 0.5;
+            std::lognormal_distribution<double> duration(std::log(m_settings.fixationDuration) - sigma * sigma / 2,
+                                                         sigma);
+            m_phaseDuration = duration(m_random);
+        } else if (m_elapsed >= m_nextBlink) {
+            m_phase = Phase::Blink;
+            m_phaseDuration = std::bernoulli_distribution(m_settings.trackingLossProbability)(m_random)
+                                  ? std::uniform_real_distribution<double>(0.5, 2.0)(m_random)
+                                  : std::uniform_real_distribution<double>(0.1, 0.2)(m_random);
+            m_nextBlink =
+                m_elapsed + std::exponential_distribution<double>(1.0 / m_settings.blinkInterval)(m_random);
+        } else if (std::bernoulli_distribution(m_settings.pursuitProbability)(m_random)) {
+            m_phase = Phase::Pursuit;
+            m_to = RandomTarget();
+            const double speed = std::uniform_real_distribution<double>(5.0, 30.0)(m_random);
+            m_phaseDuration = std::max(AngularDistance(m_from, m_to) / speed, 0.1);
+        } else {
+            m_phase = Phase::Saccade;
+            m_to = RandomTarget();
+            // Main sequence: the duration grows linearly with the amplitude.
+            m_phaseDuration = (2.2 * AngularDistance(m_from, m_to) + 21.0) / 1000.0;
+        }
+    }
+
+    varjo_Gaze GazeSynthesizer::Next() {
+        const double dt = 1.0 / m_settings.rate;
+        m_timeNs += static_cast<int64_t>(1e9 * dt);
+        m_elapsed += dt;
+        m_phaseElapsed += dt;
+        if (m_phaseElapsed >= m_phaseDuration) {
+            m_angles = m_phase == Phase::Saccade || m_phase == Phase::Pursuit ? m_to : m_angles;
+            StartNextMovement();
+        }
+
+        const double t = std::min(m_phaseElapsed / m_phaseDuration, 1.0);
+        if (m_phase == Phase::Saccade) {
+            const double s = MinimumJerk(t);
+            m_angles = {m_from.yaw + s * (m_to.yaw - m_from.yaw), m_from.pitch + s * (m_to.pitch - m_from.pitch)};
+        } else if (m_phase == Phase::Pursuit) {
+            m_angles = {m_from.yaw + t * (m_to.yaw - m_from.yaw), m_from.pitch + t * (m_to.pitch - m_from.pitch)};
+        }
+
+        varjo_Gaze gaze{};
+        gaze.captureTime = m_timeNs;
+        gaze.frameNumber = m_frameNumber++;
+        if (m_phase == Phase::Blink) {
+            gaze.status = 0 /* Invalid */;
+            return gaze;
+        }
+
+        std::normal_distribution<double> noise(0.0, m_settings.noise);
+        FromAngles({m_angles.yaw + noise(m_random), m_angles.pitch + noise(m_random)}, gaze.gaze);
+        gaze.leftEye = gaze.rightEye = gaze.gaze;
+        gaze.focusDistance = 1.0;
+        gaze.stability = m_phase == Phase::Fixation ? 1.0 : 0.9;
+        gaze.leftStatus = gaze.rightStatus = 3 /* Tracked */;
+        gaze.status = 2 /* Valid */;
+        gaze.leftPupilSize = gaze.rightPupilSize = 0.5;
+        return gaze;
+    }
+
+} // namespace quadinator::gaze
@@ -0,0 +1,145 @@
+// MIT License
+//
+// Copyright(c) 2023 Matthieu Bucchianeri
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this softwareand associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright noticeand this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+// Gaze traces (recording and synthesis), shared between the DLL and the offline tools.
+// This header must remain portable (no Windows or Detours dependencies).
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <vector>
+
+#include <Varjo_types.h>
+
+#include "gaze.h"
+
+namespace quadinator::gaze {
+
+    // Binary trace format: a TraceHeader followed by TraceRecords, little-endian.
+    constexpr uint32_t TraceMagic = 0x545a4751; // "QGZT"
+    constexpr uint32_t TraceVersion = 1;
+
+    struct TraceHeader {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t recordSize;
+        uint32_t reserved;
+    };
+
+    // A compact gaze sample: directions and metrics in single precision.
+    struct TraceRecord {
+        int64_t captureTime;
+        int64_t frameNumber;
+        float gaze[3];
+        float leftEye[3];
+        float rightEye[3];
+        float focusDistance;
+        float stability;
+        float leftPupilSize;
+        float rightPupilSize;
+        int8_t status;
+        int8_t leftStatus;
+        int8_t rightStatus;
+        int8_t padding;
+    };
+    static_assert(sizeof(TraceRecord) == 72);
+
+    TraceRecord ToTraceRecord(const varjo_Gaze& gaze);
+    varjo_Gaze FromTraceRecord(const TraceRecord& record);
+
+    // Appends samples to a trace file. Not thread-safe.
+    class TraceWriter {
+      public:
+        bool Open(const std::filesystem::path& path);
+        void Write(const varjo_Gaze& gaze);
+        void Flush();
+        void Close();
+
+        bool IsOpen() const {
+            return m_file.is_open();
+        }
+
+      private:
+        std::ofstream m_file;
+    };
+
+    // Load a binary trace, or a CSV trace (capture_time_ns,forward_x,forward_y,forward_z[,status] per line, '#' for
+    // comments).
+    bool LoadTrace(const std::filesystem::path& path, std::vector<varjo_Gaze>& samples);
+
+    struct SynthesisSettings {
+        // Sampling rate of the eye tracker.
+        double rate{200.0};
+
+        // Mean fixation duration (seconds), log-normally distributed.
+        double fixationDuration{0.25};
+
+        // Fixational noise (degrees, standard deviation per sample).
+        double noise{0.1};
+
+        // Probability that an eye movement is a smooth pursuit rather than a saccade.
+        double pursuitProbability{0.1};
+
+        // Mean time between blinks (seconds), and probability that a blink becomes a longer tracking loss.
+        double blinkInterval{4.0};
+        double trackingLossProbability{0.1};
+    };
+
+    // Synthesizes a realistic gaze stream: fixations with noise, saccades following the main sequence, smooth
+    // pursuits, blinks and tracking losses. Deterministic for a given seed.
+    class GazeSynthesizer {
+      public:
+        GazeSynthesizer(uint32_t seed, const SynthesisSettings& settings = {});
+
+        // The next sample, at the sampling rate.
+        varjo_Gaze Next();
+
+      private:
+        enum class Phase {
+            Fixation,
+            Saccade,
+            Pursuit,
+            Blink,
+        };
+
+        void StartNextMovement();
+        GazeAngles RandomTarget();
+
+        const SynthesisSettings m_settings;
+        std::mt19937 m_random;
+        int64_t m_timeNs{0};
+        int64_t m_frameNumber{0};
+
+        Phase m_phase{Phase::Fixation};
+        double m_phaseElapsed{0.0};
+        double m_phaseDuration{0.0};
+        GazeAngles m_from{};
+        GazeAngles m_to{};
+        GazeAngles m_angles{};
+        double m_nextBlink{0.0};
+        double m_elapsed{0.0};
+    };
+
+} // namespace quadinator::gaze
@@ -0,0 +1,245 @@
+// MIT License
+//
+// Copyright(c) 2023 Matthieu Bucchianeri
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this softwareand associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright noticeand this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+// The resolution and carving math, shared between the DLL hooks and the offline tools.
+// This header must remain portable (no Windows or Detours dependencies).
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+
+#include <Varjo_types.h>
+#include <Varjo_types_layers.h>
+
+namespace quadinator {
+
+    // The views of a multi-projection layer: the stereo views (one per eye) come first, followed by the focus views,
+    // one focus region after the other (eg: the left and right focus views are 2 and 3 for the quad views).
+    constexpr int32_t StereoViewCount = 2;
+
+    // The runtimes report the quad views when they do not report the view count.
+    constexpr int32_t DefaultViewCount = 2 * StereoViewCount;
+
+    // Most views carved in a layer. The views beyond are passed through.
+    constexpr int32_t MaxViewCount = 16;
+    constexpr int32_t MaxFocusViewCount = MaxViewCount - StereoViewCount;
+
+    // The stereo view that each view is carved out of.
+    constexpr std::array<int32_t, MaxViewCount> ReferenceViews = [] {
+        std::array<int32_t, MaxViewCount> references{};
+        for (int32_t i = 0; i < MaxViewCount; i++) {
+            references[i] = i % StereoViewCount;
+        }
+        return references;
+    }();
+
+    inline bool IsFocusView(int32_t viewIndex) {
+        return viewIndex >= StereoViewCount && viewIndex < MaxViewCount;
+    }
+
+    // Settings that affect the resolution of the stereo views and the carving of the focus views.
+    struct SizingSettings {
+        // Scale applied to the pixel density of the stereo views, relative to the focus views PPD.
+        double ppdScale{1.0};
+
+        // Fraction of the focus FOV trimmed (evenly on each edge) before carving the focus views.
+        double fovCrop{0.0};
+
+        // Alignment (power-of-two) of the texture sizes and carved viewports.
+        uint32_t alignment{2};
+    };
+
+    inline uint32_t AlignTo(uint32_t n, uint32_t alignment) {
+        // Must be power-of-two.
+        return (n + alignment - 1) & ~(alignment - 1);
+    }
+
+    // Coarsest alignment accepted, well within the range of the texture sizes.
+    constexpr uint32_t MaxAlignment = 1024;
+
+    inline bool IsValidAlignment(uint32_t alignment) {
+        return alignment && alignment <= MaxAlignment && (alignment & (alignment - 1)) == 0;
+    }
+
+    struct TextureMultipliers {
+        double horizontal;
+        double vertical;
+    };
+
+    // Compute the factors to transpose the focus view resolution to the full FOV while keeping a uniform PPD.
+    inline TextureMultipliers ComputeTextureMultipliers(const varjo_FovTangents& fullFovTangents,
+                                                        const varjo_FovTangents& focusFovTangents) {
+        return {std::abs(fullFovTangents.right - fullFovTangents.left) /
+                    std::abs(focusFovTangents.right - focusFovTangents.left),
+                std::abs(fullFovTangents.top - fullFovTangents.bottom) /
+                    std::abs(focusFovTangents.top - focusFovTangents.bottom)};
+    }
+
+    // Combine the multipliers of two focus positions, so that the PPD is kept at both positions.
+    inline TextureMultipliers MaxTextureMultipliers(const TextureMultipliers& a, const TextureMultipliers& b) {
+        return {std::max(a.horizontal, b.horizontal), std::max(a.vertical, b.vertical)};
+    }
+
+    // Combine the multipliers of every position of the focus (eg: the nodes of a focus grid).
+    template <typename FocusPositions>
+    TextureMultipliers ComputeEnvelopeMultipliers(const varjo_FovTangents& fullFovTangents,
+                                                  const FocusPositions& focusFovTangents) {
+        TextureMultipliers multipliers{};
+        for (const varjo_FovTangents& tangents : focusFovTangents) {
+            multipliers = MaxTextureMultipliers(multipliers, ComputeTextureMultipliers(fullFovTangents, tangents));
+        }
+        return multipliers;
+    }
+
+    // Compute the stereo view resolution from the focus view resolution.
+    inline void ComputeStereoTextureSize(const TextureMultipliers& multipliers,
+                                         const SizingSettings& settings,
+                                         int32_t* width,
+                                         int32_t* height) {
+        *width = static_cast<int32_t>(
+            AlignTo(static_cast<uint32_t>(*width * multipliers.horizontal * settings.ppdScale), settings.alignment));
+        *height = static_cast<int32_t>(
+            AlignTo(static_cast<uint32_t>(*height * multipliers.vertical * settings.ppdScale), settings.alignment));
+    }
+
+    // Compute the stereo view resolution that keeps the PPD of every focus view carved out of it.
+    // sizeFocusView(focusView, &width, &height) returns the focus view resolution and its multipliers.
+    template <typename SizeFocusView>
+    void ComputeStereoViewTextureSize(int32_t stereoView,
+                                      int32_t viewCount,
+                                      const SizingSettings& settings,
+                                      SizeFocusView&& sizeFocusView,
+                                      int32_t* width,
+                                      int32_t* height) {
+        *width = *height = 0;
+        for (int32_t focusView = StereoViewCount; focusView < std::min(viewCount, MaxViewCount); focusView++) {
+            if (ReferenceViews[focusView] != stereoView) {
+                continue;
+            }
+
+            int32_t focusWidth, focusHeight;
+            const TextureMultipliers multipliers = sizeFocusView(focusView, &focusWidth, &focusHeight);
+            ComputeStereoTextureSize(multipliers, settings, &focusWidth, &focusHeight);
+            *width = std::max(*width, focusWidth);
+            *height = std::max(*height, focusHeight);
+        }
+    }
+
+    // Trim the focus FOV around its center.
+    inline varjo_FovTangents CropFovTangents(const varjo_FovTangents& tangents, double crop) {
+        if (crop <= 0.0) {
+            return tangents;
+        }
+
+        const double scale = 1.0 - std::min(crop, 0.99);
+        const double horizontalCenter = (tangents.left + tangents.right) / 2;
+        const double verticalCenter = (tangents.top + tangents.bottom) / 2;
+        varjo_FovTangents result = tangents;
+        result.left = horizontalCenter + (tangents.left - horizontalCenter) * scale;
+        result.right = horizontalCenter + (tangents.right - horizontalCenter) * scale;
+        result.top = verticalCenter + (tangents.top - verticalCenter) * scale;
+        result.bottom = verticalCenter + (tangents.bottom - verticalCenter) * scale;
+        return result;
+    }
+
+    // The focus view rectangle, expressed as fractions of the reference (full FOV) view.
+    struct CarveFractions {
+        double x;
+        double y;
+        double width;
+        double height;
+    };
+
+    inline CarveFractions ComputeCarveFractions(const varjo_AlignedView& fullFovTangents,
+                                                const varjo_FovTangents& focusFovTangents) {
+        const double horizontalFov = fullFovTangents.projectionRight + fullFovTangents.projectionLeft;
+        const double verticalFov = fullFovTangents.projectionTop + fullFovTangents.projectionBottom;
+        return {(focusFovTangents.left + fullFovTangents.projectionLeft) / horizontalFov,
+                (fullFovTangents.projectionTop - focusFovTangents.top) / verticalFov,
+                std::abs(focusFovTangents.right - focusFovTangents.left) / horizontalFov,
+                std::abs(focusFovTangents.top - focusFovTangents.bottom) / verticalFov};
+    }
+
+    // Trim the carved focus view around its center, like CropFovTangents() trims the focus FOV.
+    inline CarveFractions CropCarveFractions(const CarveFractions& fractions, double crop) {
+        if (crop <= 0.0) {
+            return fractions;
+        }
+
+        const double scale = 1.0 - std::min(crop, 0.99);
+        return {fractions.x + fractions.width * (1.0 - scale) / 2,
+                fractions.y + fractions.height * (1.0 - scale) / 2,
+                fractions.width * scale,
+                fractions.height * scale};
+    }
+
+    // Patch the viewport to carve the focus view out of the full view. The placeholder position of the focus view is
+    // ignored: the carve is placed relative to the full view (which may be offset in its swapchain, eg: side-by-side
+    // stereo). The aligned viewport is clamped to the full view, so that the rounding never reaches outside of it.
+    inline void CarveViewport(varjo_SwapChainViewport& focusViewport,
+                              const varjo_SwapChainViewport& referenceViewport,
+                              const CarveFractions& fractions,
+                              uint32_t alignment) {
+        const auto carve = [alignment](int32_t& offset,
+                                       int32_t& size,
+                                       int32_t referenceOffset,
+                                       int32_t referenceSize,
+                                       double offsetFraction,
+                                       double sizeFraction) {
+            offset = std::clamp(referenceOffset + static_cast<int32_t>(offsetFraction * referenceSize),
+                                referenceOffset,
+                                referenceOffset + referenceSize);
+            const auto alignedSize = AlignTo(static_cast<uint32_t>(sizeFraction * referenceSize), alignment);
+            size = std::min(static_cast<int32_t>(alignedSize), referenceOffset + referenceSize - offset);
+        };
+
+        focusViewport.swapChain = referenceViewport.swapChain;
+        focusViewport.arrayIndex = referenceViewport.arrayIndex;
+        carve(focusViewport.x,
+              focusViewport.width,
+              referenceViewport.x,
+              referenceViewport.width,
+              fractions.x,
+              fractions.width);
+        carve(focusViewport.y,
+              focusViewport.height,
+              referenceViewport.y,
+              referenceViewport.height,
+              fractions.y,
+              fractions.height);
+    }
+
+    // Equivalent of varjo_GetAlignedView() on the projection built from the tangents, for use where no projection
+    // matrix is available (eg: offline tools).
+    inline varjo_AlignedView AlignedViewFromTangents(const varjo_FovTangents& tangents) {
+        varjo_AlignedView view{};
+        view.projectionLeft = -tangents.left;
+        view.projectionRight = tangents.right;
+        view.projectionTop = tangents.top;
+        view.projectionBottom = -tangents.bottom;
+        return view;
+    }
+
+} // namespace quadinator
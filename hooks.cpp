@@ -0,0 +1,1247 @@
+// MIT License
+//
+// Copyright(c) 2023 Matthieu Bucchianeri
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this softwareand associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright noticeand this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <Varjo.h>
+#include <Varjo_layers.h>
+#include <Varjo_math.h>
+
+#include "arena.h"
+#include "config.h"
+#include "control.h"
+#include "focusgrid.h"
+#include "gaze.h"
+#include "gazepoller.h"
+#include "gazetrace.h"
+#include "geometry.h"
+#include "hooks.h"
+#include "interpose.h"
+#include "session.h"
+#include "sharedgeometry.h"
+#include "stats.h"
+#include "tracing.h"
+
+/////////////////////////////////////////////////////////////////////////////
+// Begin, Fun.
+
+namespace {
+
+    using namespace quadinator;
+    using quadinator::config::Config;
+
+    // clang-format off
+    struct varjo_AlignedView (*original_GetAlignedView)(double* projectionMatrix) = nullptr;
+    struct varjo_FovTangents (*original_GetFovTangents)(struct varjo_Session* session,
+                                                        int32_t viewIndex) = nullptr;
+    struct varjo_FovTangents (*original_GetFoveatedFovTangents)(struct varjo_Session* session,
+                                                                int32_t indexView,
+                                                                struct varjo_Gaze* gaze,
+                                                                struct varjo_FoveatedFovTangents_Hints* hints) = nullptr;
+    varjo_Bool (*original_GetRenderingGaze)(struct varjo_Session* session,
+                                            struct varjo_Gaze* gaze) = nullptr;
+    varjo_Nanoseconds (*original_FrameGetDisplayTime)(struct varjo_Session* session) = nullptr;
+    int32_t (*original_GetViewCount)(struct varjo_Session* session) = nullptr;
+    // clang-format on
+
+    std::filesystem::path g_dllRoot;
+
+    // Each session records the eye tracker samples to its own trace, written from its polling thread only. The traces
+    // are numbered in the order the sessions start polling.
+    std::atomic<uint64_t> g_gazeTraceCount{0};
+
+    // Flush the trace about once per second.
+    constexpr uint64_t GazeTraceFlushInterval = 200;
+
+    // The focus geometry of the previous frame, reused while the stabilized gaze does not move.
+    struct FocusGeometry {
+        bool isValid{false};
+        varjo_Ray gaze{};
+        double fovCrop{0.0};
+        varjo_FovTangents tangents{};
+        varjo_Matrix projection{};
+
+        // The carve from the focus grid, out of the full FOV of the grid.
+        bool hasFractions{false};
+        CarveFractions fractions{};
+        varjo_AlignedView fractionsFullFov{};
+    };
+
+    // The state of a session. The runtime in vrserver.exe serves several sessions at once, so nothing that depends on
+    // the session is global.
+    struct SessionState {
+        explicit SessionState(varjo_Session* session) : session(session) {
+        }
+
+        ~SessionState() {
+            for (auto& grid : focusGrids) {
+                delete grid.load(std::memory_order_relaxed);
+            }
+            for (auto& geometry : sharedGeometry) {
+                delete geometry.load(std::memory_order_relaxed);
+            }
+        }
+
+        varjo_Session* const session;
+
+        // Settings that affect the texture sizes are latched for the duration of a session, since the application
+        // only queries the texture sizes once.
+        const Config config{*config::Current()};
+
+        // The eye tracker is sampled in the background, from the first frame. Stopped when the state is deleted.
+        std::mutex gazePollerMutex;
+        gaze::GazePoller gazePoller;
+        std::atomic<bool> isGazePollerStarted{false};
+
+        // The focus grids are built when the texture sizes are queried, and read when submitting the frames. The
+        // lookups are disabled if a grid does not match the runtime.
+        std::mutex focusGridsMutex;
+        std::atomic<const FocusGrid*> focusGrids[MaxFocusViewCount]{};
+        std::atomic<bool> focusGridsDisabled{false};
+
+        // The geometry of the focus views shared with the other processes, installed (under focusGridsMutex) when the
+        // texture sizes are queried. The frames that carve the same focus FOV use its carve.
+        std::atomic<const shared::ViewGeometry*> sharedGeometry[MaxFocusViewCount]{};
+
+        // Only used from the frame submission thread.
+        gaze::GazePredictor gazePredictor;
+        gaze::GazeStabilizer gazeStabilizer;
+        gaze::GazeFallback gazeFallback;
+        uint64_t nextGazeSample{0};
+        uint64_t focusGridLookups{0};
+        std::array<FocusGeometry, MaxFocusViewCount> focusGeometry;
+
+        // The copies of the submitted layers (with their views and extensions), reused from frame to frame. Only used
+        // from the frame submission thread.
+        std::vector<varjo_LayerHeader*> layers;
+        FrameArena copies;
+
+        stats::FrameStats frameStats;
+    };
+
+    // Never destroyed: deleting the states would join the polling threads from DLL_PROCESS_DETACH, and deadlock on
+    // the loader lock.
+    SessionMap<SessionState>& g_sessions = *new SessionMap<SessionState>;
+
+    // The session that last submitted a frame, for the control channel.
+    std::atomic<varjo_Session*> g_lastSession{nullptr};
+
+    void StartGazePoller(SessionState& state) {
+        if (state.isGazePollerStarted.load(std::memory_order_acquire)) {
+            return;
+        }
+        std::unique_lock lock(state.gazePollerMutex);
+        if (state.isGazePollerStarted.load(std::memory_order_relaxed)) {
+            return;
+        }
+
+        gaze::GazePoller::Listener listener;
+        if (!state.config.gazeTrace.empty()) {
+            auto path = g_dllRoot / state.config.gazeTrace;
+            path += "." + std::to_string(g_gazeTraceCount.fetch_add(1, std::memory_order_relaxed) + 1);
+            auto writer = std::make_shared<gaze::TraceWriter>();
+            const bool opened = writer->Open(path);
+            TraceLoggingWrite(g_traceProvider,
+                              "GazeTrace_Open",
+                              TLPArg(state.session, "Session"),
+                              TLArg(path.c_str(), "Path"),
+                              TLArg(opened, "Opened"));
+            if (opened) {
+                listener = [writer = std::move(writer), count = uint64_t(0)](const varjo_Gaze& gaze) mutable {
+                    writer->Write(gaze);
+                    if (++count % GazeTraceFlushInterval == 0) {
+                        writer->Flush();
+                    }
+                };
+            }
+        }
+
+        varjo_Session* const session = state.session;
+        state.gazePoller.Start([session](varjo_Gaze* gaze) { return original_GetRenderingGaze(session, gaze); },
+                               std::move(listener));
+        state.isGazePollerStarted.store(true, std::memory_order_release);
+        TraceLoggingWrite(g_traceProvider, "GazePoller_Start", TLPArg(session, "Session"));
+    }
+
+    void StopGazePoller(SessionState& state) {
+        std::unique_lock lock(state.gazePollerMutex);
+        if (!state.isGazePollerStarted.load(std::memory_order_relaxed)) {
+            return;
+        }
+
+        state.gazePoller.Stop();
+        state.isGazePollerStarted.store(false, std::memory_order_release);
+        TraceLoggingWrite(g_traceProvider, "GazePoller_Stop", TLPArg(state.session, "Session"));
+    }
+
+    // A polled sample is not used once the poller has not heard from the eye tracker for this long (many polling
+    // periods, to allow for the coarse timer of the OS): the runtime is queried instead.
+    constexpr auto MaxPolledGazeAge = std::chrono::milliseconds(50);
+
+    // The latest sample from the poller, without calling into the runtime.
+    bool GetPolledGaze(const SessionState& state, struct varjo_Gaze* gaze) {
+        if (!state.isGazePollerStarted.load(std::memory_order_acquire) ||
+            std::chrono::steady_clock::now() - state.gazePoller.lastPollTime() > MaxPolledGazeAge) {
+            return false;
+        }
+        return state.gazePoller.ring().Latest(*gaze);
+    }
+
+    void GetForwardGaze(struct varjo_Gaze* gaze) {
+        *gaze = {};
+        gaze->leftEye.forward[2] = gaze->rightEye.forward[2] = gaze->gaze.forward[2] = 1.0;
+        // gaze->leftPupilSize = gaze->rightPupilSize = 0.5;
+        gaze->leftStatus = gaze->rightStatus = 3;
+        gaze->stability = 1.0;
+        gaze->status = 2;
+    }
+
+    // The stereo texture was sized for the gaze envelope (or not) when the session started, so whether the focus
+    // follows the gaze is latched with the session.
+    varjo_Bool GetRenderingGaze(const SessionState& state, struct varjo_Gaze* gaze) {
+        if (state.config.useFoveatedGaze) {
+            return GetPolledGaze(state, gaze) || original_GetRenderingGaze(state.session, gaze);
+        }
+
+        GetForwardGaze(gaze);
+        return true;
+    }
+
+    // Feed the predictor with the samples polled since the last frame.
+    void UpdateGazePredictor(const Config& config, SessionState& state) {
+        state.gazePredictor.SetType(config.gazePredictor);
+
+        const auto& ring = state.gazePoller.ring();
+        const uint64_t count = ring.Count();
+        uint64_t index = state.nextGazeSample;
+        if (count > gaze::GazeRing::Capacity) {
+            index = std::max(index, count - gaze::GazeRing::Capacity);
+        }
+        for (; index < count; index++) {
+            varjo_Gaze sample;
+            if (ring.Read(index, sample) && sample.status == 2 /* Valid */) {
+                state.gazePredictor.Update(sample.captureTime, gaze::ToAngles(sample.gaze));
+            }
+        }
+        state.nextGazeSample = count;
+    }
+
+    // Sample the gaze once for the frame, fall back to a forward gaze when the tracking is lost, extrapolate it to the
+    // predicted display time, and hold it during fixations.
+    // The gaze settings are live, except foveated_gaze (see GetRenderingGaze()).
+    bool GetFrameGaze(const Config& config, SessionState& state, struct varjo_Gaze* gaze) {
+        if (!state.config.useFoveatedGaze) {
+            return GetRenderingGaze(state, gaze);
+        }
+
+        StartGazePoller(state);
+        UpdateGazePredictor(config, state);
+
+        varjo_Gaze sample{};
+        if (!GetRenderingGaze(state, &sample)) {
+            sample.status = 0 /* Invalid */;
+        }
+
+        const int64_t now =
+            std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+                .count();
+        const auto previousState = state.gazeFallback.state();
+        const double weight = state.gazeFallback.Update(now, sample, config.gazeBlendMs / 1e3);
+        if (state.gazeFallback.state() != previousState) {
+            TraceLoggingWrite(g_traceProvider,
+                              "GazeTracking",
+                              TLArg(static_cast<int>(state.gazeFallback.state()), "State"),
+                              TLArg(sample.status, "Status"),
+                              TLArg(sample.leftStatus, "LeftStatus"),
+                              TLArg(sample.rightStatus, "RightStatus"),
+                              TLArg(sample.stability, "Stability"));
+        }
+        if (weight <= 0) {
+            GetForwardGaze(gaze);
+            return true;
+        }
+
+        // During a short drop-out, this is the last good sample.
+        *gaze = state.gazeFallback.lastGood();
+        const bool isCurrentSample = gaze->captureTime == sample.captureTime;
+
+        const auto angles = gaze::ToAngles(gaze->gaze);
+        auto focus = angles;
+        if (config.gazePredictor != gaze::PredictorType::None && isCurrentSample) {
+            // No-op if the sample came from the poller, since the predictor was already fed with it.
+            state.gazePredictor.Update(gaze->captureTime, angles);
+            const varjo_Nanoseconds displayTime =
+                original_FrameGetDisplayTime
+                    ? original_FrameGetDisplayTime(state.session)
+                    : gaze->captureTime + static_cast<varjo_Nanoseconds>(config.gazeLatencyMs * 1e6);
+            focus = state.gazePredictor.Predict(displayTime);
+
+            TraceLoggingWrite(g_traceProvider,
+                              "GazePrediction",
+                              TLArg(gaze->captureTime, "CaptureTime"),
+                              TLArg(displayTime, "DisplayTime"),
+                              TLArg(angles.yaw, "Yaw"),
+                              TLArg(angles.pitch, "Pitch"),
+                              TLArg(focus.yaw, "PredictedYaw"),
+                              TLArg(focus.pitch, "PredictedPitch"));
+        }
+        // Blend between the forward gaze and the tracked gaze. The prediction may overshoot the range covered by the
+        // texture sizing.
+        focus = gaze::ClampToGazeRange(focus);
+        focus = {focus.yaw * weight, focus.pitch * weight};
+        focus = state.gazeStabilizer.Update(now, focus, config.gazeDeadZone);
+
+        // Apply the same motion to each eye. The combined gaze is set exactly, so that it can be compared across
+        // frames.
+        const gaze::GazeAngles delta{focus.yaw - angles.yaw, focus.pitch - angles.pitch};
+        for (varjo_Ray* ray : {&gaze->leftEye, &gaze->rightEye}) {
+            const auto eyeAngles = gaze::ToAngles(*ray);
+            gaze::FromAngles({eyeAngles.yaw + delta.yaw, eyeAngles.pitch + delta.pitch}, *ray);
+        }
+        gaze::FromAngles(focus, gaze->gaze);
+        return true;
+    }
+
+    // When no gaze is passed, the current gaze is queried.
+    struct varjo_FovTangents GetFovTangents(const Config& config,
+                                            const SessionState& state,
+                                            int32_t viewIndex,
+                                            struct varjo_Gaze* gaze = nullptr) {
+        varjo_Gaze currentGaze{};
+        if (config.useFoveatedTangents && !gaze && GetRenderingGaze(state, &currentGaze)) {
+            gaze = &currentGaze;
+        }
+        if (config.useFoveatedTangents && gaze) {
+            varjo_FoveatedFovTangents_Hints hints = config.foveationHints;
+            return original_GetFoveatedFovTangents(state.session, viewIndex, gaze, &hints);
+        } else {
+            return original_GetFovTangents(state.session, viewIndex);
+        }
+    }
+
+    // The views of the layers, including the focus views. The views beyond the ones that are carved are not sized.
+    int32_t GetViewCount(struct varjo_Session* session) {
+        const int32_t viewCount = original_GetViewCount ? original_GetViewCount(session) : DefaultViewCount;
+        return std::clamp(viewCount, DefaultViewCount, MaxViewCount);
+    }
+
+    // Largest acceptable difference between the focus grid and the runtime, in tangent units (about 0.05 degree).
+    constexpr double MaxFocusGridError = 1e-3;
+
+    // One out of this many lookups in the focus grids is verified against the runtime.
+    constexpr uint64_t FocusGridCheckInterval = 64;
+
+    // The projection of the nodes of the focus grids.
+    varjo_Matrix ProjectFocusGridNode(const varjo_FovTangents& tangents) {
+        varjo_FovTangents copy = tangents;
+        return varjo_GetProjectionMatrix(&copy);
+    }
+
+    // Largest difference between two aligned views, in tangent units.
+    double AlignedViewDistance(const varjo_AlignedView& a, const varjo_AlignedView& b) {
+        return std::max({std::abs(a.projectionLeft - b.projectionLeft),
+                         std::abs(a.projectionRight - b.projectionRight),
+                         std::abs(a.projectionTop - b.projectionTop),
+                         std::abs(a.projectionBottom - b.projectionBottom)});
+    }
+
+    // The focus grids are indexed by focus view.
+    const FocusGrid& BuildFocusGrid(const Config& config, SessionState& state, int32_t viewIndex) {
+        std::unique_lock lock(state.focusGridsMutex);
+        auto& slot = state.focusGrids[viewIndex - StereoViewCount];
+        const FocusGrid* grid = slot.load(std::memory_order_acquire);
+        if (!grid) {
+            varjo_Gaze gaze;
+            GetForwardGaze(&gaze);
+            grid = new FocusGrid(
+                [&](const gaze::GazeAngles& angles) {
+                    for (varjo_Ray* ray : {&gaze.leftEye, &gaze.rightEye, &gaze.gaze}) {
+                        gaze::FromAngles(angles, *ray);
+                    }
+                    return GetFovTangents(config, state, viewIndex, &gaze);
+                },
+                ProjectFocusGridNode,
+                GetFovTangents(config, state, ReferenceViews[viewIndex]),
+                FocusGridStep);
+            slot.store(grid, std::memory_order_release);
+            TraceLoggingWrite(g_traceProvider,
+                              "FocusGrid_Build",
+                              TLArg(viewIndex, "ViewIndex"),
+                              TLArg(grid->nodes().size(), "Nodes"));
+        }
+        return *grid;
+    }
+
+    // The focus geometry for the gaze from the focus grid, or nullptr if there is no grid to use (the geometry must
+    // then be queried from the runtime).
+    const FocusGrid* LookupFocusGrid(const Config& config,
+                                     SessionState& state,
+                                     int32_t viewIndex,
+                                     struct varjo_Gaze* gaze,
+                                     FocusGrid::Geometry& geometry) {
+        const FocusGrid* grid = config.useFoveatedTangents && gaze && IsFocusView(viewIndex)
+                                    ? state.focusGrids[viewIndex - StereoViewCount].load(std::memory_order_acquire)
+                                    : nullptr;
+        if (!grid || state.focusGridsDisabled.load(std::memory_order_relaxed)) {
+            return nullptr;
+        }
+
+        geometry = grid->Lookup(gaze::ToAngles(gaze->gaze));
+        stats::g_cacheStats.gridLookups.fetch_add(1, std::memory_order_relaxed);
+        if (state.focusGridLookups++ % FocusGridCheckInterval == 0) {
+            // The projection is verified through the FOV it describes.
+            const auto expected = GetFovTangents(config, state, viewIndex, gaze);
+            const double error =
+                std::max(FocusGrid::Distance(geometry.tangents, expected),
+                         AlignedViewDistance(original_GetAlignedView(geometry.projection.value),
+                                             AlignedViewFromTangents(expected)));
+            if (error > MaxFocusGridError) {
+                TraceLoggingWrite(
+                    g_traceProvider, "FocusGrid_Error", TLArg(viewIndex, "ViewIndex"), TLArg(error, "Error"));
+                stats::g_cacheStats.gridCheckFailures.fetch_add(1, std::memory_order_relaxed);
+                if (!state.focusGridsDisabled.exchange(true, std::memory_order_relaxed)) {
+                    stats::g_cacheStats.gridDisables.fetch_add(1, std::memory_order_relaxed);
+                }
+                return nullptr;
+            }
+        }
+        return grid;
+    }
+
+    // The multipliers that keep the focus PPD for every focus position within the gaze range.
+    TextureMultipliers ComputeGazeEnvelopeMultipliers(const Config& config,
+                                                      SessionState& state,
+                                                      int32_t viewIndex,
+                                                      const varjo_FovTangents& fullFovTangents) {
+        const auto multipliers =
+            ComputeEnvelopeMultipliers(fullFovTangents, BuildFocusGrid(config, state, viewIndex).nodes());
+
+        TraceLoggingWrite(g_traceProvider,
+                          "GazeEnvelope",
+                          TLArg(viewIndex, "ViewIndex"),
+                          TLArg(multipliers.horizontal, "HorizontalMultiplier"),
+                          TLArg(multipliers.vertical, "VerticalMultiplier"));
+        return multipliers;
+    }
+
+    // The geometry resolved by the processes that load the DLL. Never destroyed, like the sessions.
+    shared::GeometrySegment& g_sharedGeometry = *new shared::GeometrySegment;
+
+    // Largest acceptable difference between the full FOV of a shared record and the runtime. A larger difference
+    // means that the record was resolved for another headset.
+    constexpr double MaxSharedGeometryError = 1e-6;
+
+    // The key of the shared records: the settings that affect the geometry of a view. The sessions of the
+    // application and of vrserver.exe are distinct, so the session cannot be part of the key.
+    uint64_t GetGeometryKey(const Config& config, int32_t viewIndex) {
+        // FNV-1a.
+        uint64_t hash = 0xcbf29ce484222325ull;
+        const auto mix = [&](const void* data, size_t size) {
+            for (size_t i = 0; i < size; i++) {
+                hash = (hash ^ static_cast<const uint8_t*>(data)[i]) * 0x100000001b3ull;
+            }
+        };
+        const double step = FocusGridStep;
+        mix(&viewIndex, sizeof(viewIndex));
+        mix(&config.useFoveatedTangents, sizeof(config.useFoveatedTangents));
+        mix(&config.useFoveatedGaze, sizeof(config.useFoveatedGaze));
+        mix(&config.foveationHints, sizeof(config.foveationHints));
+        mix(&step, sizeof(step));
+        return hash ? hash : 1;
+    }
+
+    // Whether a frame carves the focus FOV of the shared geometry out of the same full FOV.
+    bool IsSharedCarve(const shared::ViewGeometry& geometry,
+                       const varjo_AlignedView& fullFovTangents,
+                       const varjo_FovTangents& focusFovTangents,
+                       double fovCrop) {
+        return AlignedViewDistance(AlignedViewFromTangents(geometry.fullFovTangents), fullFovTangents) <=
+                   MaxSharedGeometryError &&
+               FocusGrid::Distance(CropFovTangents(geometry.focusFovTangents, fovCrop), focusFovTangents) <=
+                   MaxSharedGeometryError;
+    }
+
+    void InstallSharedGeometry(SessionState& state, int32_t viewIndex, const shared::ViewGeometry& geometry) {
+        std::unique_lock lock(state.focusGridsMutex);
+        auto& slot = state.sharedGeometry[viewIndex - StereoViewCount];
+        if (!slot.load(std::memory_order_relaxed)) {
+            auto* copy = new shared::ViewGeometry(geometry);
+            copy->gridNodes.clear();
+            slot.store(copy, std::memory_order_release);
+        }
+    }
+
+    void InstallFocusGrid(SessionState& state,
+                          int32_t viewIndex,
+                          std::vector<varjo_FovTangents> nodes,
+                          const varjo_FovTangents& fullFovTangents) {
+        std::unique_lock lock(state.focusGridsMutex);
+        auto& slot = state.focusGrids[viewIndex - StereoViewCount];
+        if (!slot.load(std::memory_order_relaxed)) {
+            slot.store(new FocusGrid(std::move(nodes), ProjectFocusGridNode, fullFovTangents, FocusGridStep),
+                       std::memory_order_release);
+        }
+    }
+
+    // The geometry of a focus view and its reference view, from the shared records when another process resolved it
+    // with the same settings and headset. Otherwise, it is resolved from the runtime and published.
+    shared::ViewGeometry ResolveViewGeometry(const Config& config, SessionState& state, int32_t viewIndex) {
+        const bool useGazeEnvelope = config.useFoveatedTangents && config.useFoveatedGaze;
+        const uint64_t key = GetGeometryKey(config, viewIndex);
+
+        const auto fullFovTangents = GetFovTangents(config, state, ReferenceViews[viewIndex]);
+        shared::ViewGeometry geometry;
+        if (g_sharedGeometry.Lookup(key, geometry)) {
+            const bool isValid =
+                FocusGrid::Distance(geometry.fullFovTangents, fullFovTangents) <= MaxSharedGeometryError &&
+                (!useGazeEnvelope || geometry.gridNodes.size() == FocusGrid::NodeCount(FocusGridStep));
+            TraceLoggingWrite(
+                g_traceProvider, "SharedGeometry_Lookup", TLArg(viewIndex, "ViewIndex"), TLArg(isValid, "Valid"));
+            if (isValid) {
+                // The grid lookups are still verified against the runtime.
+                if (useGazeEnvelope) {
+                    InstallFocusGrid(state, viewIndex, std::move(geometry.gridNodes), geometry.fullFovTangents);
+                }
+                InstallSharedGeometry(state, viewIndex, geometry);
+                stats::g_cacheStats.sharedHits.fetch_add(1, std::memory_order_relaxed);
+                return geometry;
+            }
+            geometry = {};
+        }
+        stats::g_cacheStats.sharedMisses.fetch_add(1, std::memory_order_relaxed);
+        geometry.fullFovTangents = fullFovTangents;
+
+        // When the focus follows the gaze, keep the PPD wherever the focus can be.
+        geometry.focusFovTangents = GetFovTangents(config, state, viewIndex);
+        if (useGazeEnvelope) {
+            geometry.multipliers = ComputeGazeEnvelopeMultipliers(config, state, viewIndex, geometry.fullFovTangents);
+            geometry.gridNodes = BuildFocusGrid(config, state, viewIndex).nodes();
+        } else {
+            geometry.multipliers = ComputeTextureMultipliers(geometry.fullFovTangents, geometry.focusFovTangents);
+        }
+        geometry.carveFractions =
+            ComputeCarveFractions(AlignedViewFromTangents(geometry.fullFovTangents), geometry.focusFovTangents);
+
+        const bool isPublished = g_sharedGeometry.Publish(key, geometry);
+        TraceLoggingWrite(g_traceProvider,
+                          "SharedGeometry_Publish",
+                          TLArg(viewIndex, "ViewIndex"),
+                          TLArg(isPublished, "Published"));
+        if (isPublished) {
+            InstallSharedGeometry(state, viewIndex, geometry);
+        }
+        return geometry;
+    }
+
+    // How an extension of a reference view is carried over to the carved focus views. The extensions with a viewport
+    // are carved like the color (within their own reference viewport). The others are passed as is.
+    struct ExtensionHandler {
+        varjo_ViewExtensionType type;
+        const char* name;
+        size_t size;
+
+        // Offset of the viewport within the extension, or 0 if there is none.
+        size_t viewportOffset;
+
+        // The number of carved extensions in the last frame.
+        std::atomic<uint64_t> stats::FrameStats::*carvedCount;
+    };
+
+    // The velocity scale is kept: the carved focus view shares the pixels of the reference view, so the velocities in
+    // pixels are unchanged.
+    constexpr ExtensionHandler ExtensionHandlers[] = {
+        {varjo_ViewExtensionDepthType,
+         "Depth",
+         sizeof(varjo_ViewExtensionDepth),
+         offsetof(varjo_ViewExtensionDepth, viewport),
+         &stats::FrameStats::carvedDepths},
+        {varjo_ViewExtensionDepthTestRangeType,
+         "DepthTestRange",
+         sizeof(varjo_ViewExtensionDepthTestRange),
+         0,
+         nullptr},
+        {varjo_ViewExtensionVelocityType,
+         "Velocity",
+         sizeof(varjo_ViewExtensionVelocity),
+         offsetof(varjo_ViewExtensionVelocity, viewport),
+         &stats::FrameStats::carvedVelocities},
+    };
+    constexpr size_t ExtensionHandlerCount = std::size(ExtensionHandlers);
+
+    const ExtensionHandler* FindExtensionHandler(varjo_ViewExtensionType type) {
+        for (const auto& handler : ExtensionHandlers) {
+            if (handler.type == type) {
+                return &handler;
+            }
+        }
+        return nullptr;
+    }
+
+    template <typename Extension>
+    auto& GetExtensionViewport(Extension& extension, size_t offset) {
+        constexpr bool isConst = std::is_const_v<Extension>;
+        using Viewport = std::conditional_t<isConst, const varjo_SwapChainViewport, varjo_SwapChainViewport>;
+        using Byte = std::conditional_t<isConst, const uint8_t, uint8_t>;
+        return *reinterpret_cast<Viewport*>(reinterpret_cast<Byte*>(&extension) + offset);
+    }
+
+    // The focus views submitted for carving only hold placeholders (1x1 viewports), so their extensions are rebuilt
+    // from the chain of the reference view. Only the extensions up to the last one to carve are copied to the arena,
+    // and the rest of the chain is linked as is. An unknown extension cannot be copied: if it precedes an extension to
+    // carve, it is not passed to the focus view. Returns nullptr if there is nothing to carve.
+    template <typename OnCarved>
+    varjo_ViewExtension* CarveFocusExtensions(FrameArena& arena,
+                                              const varjo_ViewExtension* chain,
+                                              const CarveFractions& fractions,
+                                              uint32_t alignment,
+                                              OnCarved&& onCarved) {
+        const varjo_ViewExtension* lastToCarve = nullptr;
+        for (const varjo_ViewExtension* extension = chain; extension; extension = extension->next) {
+            const auto* handler = FindExtensionHandler(extension->type);
+            if (handler && handler->viewportOffset) {
+                lastToCarve = extension;
+            }
+        }
+        if (!lastToCarve) {
+            return nullptr;
+        }
+
+        varjo_ViewExtension* head = nullptr;
+        varjo_ViewExtension** tail = &head;
+        for (const varjo_ViewExtension* extension = chain;; extension = extension->next) {
+            if (const auto* handler = FindExtensionHandler(extension->type)) {
+                auto* copy = static_cast<varjo_ViewExtension*>(arena.Allocate(handler->size));
+                std::memcpy(copy, extension, handler->size);
+                if (handler->viewportOffset) {
+                    auto& viewport = GetExtensionViewport(*copy, handler->viewportOffset);
+                    CarveViewport(
+                        viewport, GetExtensionViewport(*extension, handler->viewportOffset), fractions, alignment);
+                    onCarved(*handler, viewport);
+                }
+                *tail = copy;
+                tail = &copy->next;
+            }
+            if (extension == lastToCarve) {
+                break;
+            }
+        }
+        *tail = lastToCarve->next;
+        return head;
+    }
+
+    std::string SweepFoveationHints(const std::vector<std::string>& args);
+    std::string DescribeSessions(const std::vector<std::string>& args);
+    std::string DescribeSharedGeometry(const std::vector<std::string>& args);
+
+    // Only the hooks are installed while in DllMain (under the loader lock). The rest of the initialization (file
+    // I/O, threads) is deferred to the first call to a hooked function, which is guaranteed to precede the first
+    // frame.
+    std::string g_executableName;
+    void (*g_deferredInitialization)() = nullptr;
+    std::atomic<bool> g_isInitialized{false};
+    std::once_flag g_initializeOnce;
+
+    void Initialize() {
+        std::call_once(g_initializeOnce, []() {
+            if (g_deferredInitialization) {
+                g_deferredInitialization();
+            }
+            TraceLoggingWrite(g_traceProvider, "Initialize", TLArg(g_executableName.c_str(), "Executable"));
+            config::Initialize(g_dllRoot / config::ConfigFileName, g_executableName);
+            if (config::Current()->shareGeometry) {
+                [[maybe_unused]] const bool isOpen = g_sharedGeometry.Open();
+                TraceLoggingWrite(g_traceProvider, "SharedGeometry_Open", TLArg(isOpen, "Open"));
+            }
+            if (config::Current()->controlChannel) {
+                control::RegisterCommand("hints",
+                                         "hints <index> <values>  Sweep a foveation hint word in the current session",
+                                         SweepFoveationHints);
+                control::RegisterCommand("sessions",
+                                         "sessions                Statistics of the last frame of each session",
+                                         DescribeSessions);
+                control::RegisterCommand("geometry",
+                                         "geometry                Geometry shared with the other processes",
+                                         DescribeSharedGeometry);
+                control::Start();
+            }
+            g_isInitialized.store(true, std::memory_order_release);
+        });
+    }
+
+    void EnsureInitialized() {
+        if (!g_isInitialized.load(std::memory_order_acquire)) {
+            Initialize();
+        }
+    }
+
+    void (*original_GetTextureSize)(struct varjo_Session* session,
+                                    varjo_TextureSize_Type type,
+                                    int32_t viewIndex,
+                                    int32_t* width,
+                                    int32_t* height) = nullptr;
+    void hooked_GetTextureSize(struct varjo_Session* session,
+                               varjo_TextureSize_Type type,
+                               int32_t viewIndex,
+                               int32_t* width,
+                               int32_t* height) {
+        EnsureInitialized();
+        stats::ScopedLatency latency(stats::Hook::GetTextureSize);
+        TraceLocalActivity(local);
+        TraceLoggingWriteStart(local,
+                               "varjo_GetTextureSize",
+                               TLPArg(session, "Session"),
+                               TLArg(type, "TextureSize_Type"),
+                               TLArg(viewIndex, "ViewIndex"));
+
+        if (type == varjo_TextureSize_Type_Stereo && viewIndex >= 0 && viewIndex < StereoViewCount) {
+            const auto state = g_sessions.Acquire(session);
+            const Config& config = state->config;
+
+            // The stereo view must keep the PPD of each focus view carved out of it.
+            ComputeStereoViewTextureSize(
+                viewIndex,
+                GetViewCount(session),
+                config.sizing,
+                [&](int32_t focusView, int32_t* focusWidth, int32_t* focusHeight) {
+                    // Query the focus view resolution.
+                    original_GetTextureSize(session,
+                                            config.useFoveatedTangents ? varjo_TextureSize_Type_DynamicFoveation
+                                                                       : varjo_TextureSize_Type_Quad,
+                                            focusView,
+                                            focusWidth,
+                                            focusHeight);
+
+                    const auto geometry = ResolveViewGeometry(config, *state, focusView);
+                    [[maybe_unused]] const auto& fullFovTangents = geometry.fullFovTangents;
+                    [[maybe_unused]] const auto& focusFovTangents = geometry.focusFovTangents;
+                    TraceLoggingWriteTagged(local,
+                                            "varjo_GetTextureSize_FullFov",
+                                            TLArg(focusView, "ViewIndex"),
+                                            TLArg(atan(fullFovTangents.bottom), "Bottom"),
+                                            TLArg(atan(fullFovTangents.top), "Top"),
+                                            TLArg(atan(fullFovTangents.left), "Left"),
+                                            TLArg(atan(fullFovTangents.right), "Right"));
+                    TraceLoggingWriteTagged(local,
+                                            "varjo_GetTextureSize_FocusFov",
+                                            TLArg(focusView, "ViewIndex"),
+                                            TLArg(atan(focusFovTangents.bottom), "Bottom"),
+                                            TLArg(atan(focusFovTangents.top), "Top"),
+                                            TLArg(atan(focusFovTangents.left), "Left"),
+                                            TLArg(atan(focusFovTangents.right), "Right"),
+                                            TLArg(*focusWidth, "Width"),
+                                            TLArg(*focusHeight, "Height"));
+
+                    // Transpose the resolution to the full FOV while keeping a uniform PPD.
+                    const auto& multipliers = geometry.multipliers;
+                    TraceLoggingWriteTagged(local,
+                                            "varjo_GetTextureSize_Multipliers",
+                                            TLArg(focusView, "ViewIndex"),
+                                            TLArg(multipliers.horizontal, "HorizontalMultiplier"),
+                                            TLArg(multipliers.vertical, "VerticalMultiplier"));
+                    return multipliers;
+                },
+                width,
+                height);
+        } else {
+            original_GetTextureSize(session, type, viewIndex, width, height);
+        }
+
+        TraceLoggingWriteStop(local, "varjo_GetTextureSize", TLArg(*width, "Width"), TLArg(*height, "Height"));
+    }
+
+    struct varjo_ViewDescription (*original_GetViewDescription)(struct varjo_Session* session,
+                                                                int32_t viewIndex) = nullptr;
+    struct varjo_ViewDescription hooked_GetViewDescription(struct varjo_Session* session, int32_t viewIndex) {
+        EnsureInitialized();
+        stats::ScopedLatency latency(stats::Hook::GetViewDescription);
+        TraceLocalActivity(local);
+        TraceLoggingWriteStart(
+            local, "varjo_GetViewDescription", TLPArg(session, "Session"), TLArg(viewIndex, "ViewIndex"));
+
+        struct varjo_ViewDescription result = original_GetViewDescription(session, viewIndex);
+        if (viewIndex == 0 || viewIndex == 1) {
+            hooked_GetTextureSize(session, varjo_TextureSize_Type_Stereo, viewIndex, &result.width, &result.height);
+        }
+
+        TraceLoggingWriteStop(
+            local, "varjo_GetViewDescription", TLArg(result.width, "Width"), TLArg(result.width, "Height"));
+
+        return result;
+    }
+
+    void (*original_EndFrameWithLayers)(struct varjo_Session* session,
+                                        struct varjo_SubmitInfoLayers* submitInfo) = nullptr;
+    void hooked_EndFrameWithLayers(struct varjo_Session* session, struct varjo_SubmitInfoLayers* submitInfo) {
+        EnsureInitialized();
+        stats::ScopedLatency latency(stats::Hook::EndFrameWithLayers);
+        TraceLocalActivity(local);
+        TraceLoggingWriteStart(local,
+                               "varjo_EndFrameWithLayers",
+                               TLPArg(session, "Session"),
+                               TLArg(submitInfo->frameNumber, "FrameNumber"),
+                               TLArg(submitInfo->layerCount, "LayerCount"));
+
+        const auto state = g_sessions.Acquire(session);
+        g_lastSession.store(session, std::memory_order_release);
+        const Config& sessionConfig = state->config;
+        const auto currentConfigSnapshot = config::Current();
+        const Config& currentConfig = *currentConfigSnapshot;
+        const bool traceVerbose = currentConfig.traceVerbose && IsTraceEnabled();
+        uint64_t stereoPixels = 0;
+        uint64_t focusPixels = 0;
+        uint64_t carvedViews = 0;
+        uint64_t heldViews = 0;
+        uint64_t synthesizedViews = 0;
+        std::array<uint64_t, ExtensionHandlerCount> carvedExtensions{};
+
+        varjo_Gaze frameGaze{};
+        const bool hasFrameGaze = sessionConfig.useFoveatedTangents && GetFrameGaze(currentConfig, *state, &frameGaze);
+
+        struct varjo_SubmitInfoLayers newSubmitInfo = *submitInfo;
+        auto& newLayersPtr = state->layers;
+        newLayersPtr.clear();
+
+        auto& copiesAllocator = state->copies;
+        copiesAllocator.Reset();
+
+        for (int32_t i = 0; i < submitInfo->layerCount; i++) {
+            if (traceVerbose) {
+                TraceLoggingWriteTagged(
+                    local, "varjo_EndFrameWithLayers_Layer", TLArg(submitInfo->layers[i]->type, "Type"));
+            }
+            if (submitInfo->layers[i]->type == varjo_LayerMultiProjType) {
+                const varjo_LayerMultiProj* proj = reinterpret_cast<const varjo_LayerMultiProj*>(submitInfo->layers[i]);
+                if (traceVerbose) {
+                    TraceLoggingWriteTagged(local,
+                                            "varjo_EndFrameWithLayers_MultiProj",
+                                            TLArg(proj->header.flags, "Flags"),
+                                            TLArg(proj->space, "Space"),
+                                            TLArg(proj->viewCount, "ViewCount"));
+
+                    for (int32_t j = 0; j < proj->viewCount; j++) {
+                        TraceLoggingWriteTagged(local,
+                                                "varjo_EndFrameWithLayers_MultiProj",
+                                                TLArg(j, "ViewIndex"),
+                                                TLPArg(proj->views[j].viewport.swapChain, "SwapChain"),
+                                                TLArg(proj->views[j].viewport.arrayIndex, "ArrayIndex"),
+                                                TLArg(proj->views[j].viewport.x, "X"),
+                                                TLArg(proj->views[j].viewport.y, "Y"),
+                                                TLArg(proj->views[j].viewport.width, "Width"),
+                                                TLArg(proj->views[j].viewport.height, "Height"));
+
+                        [[maybe_unused]] const auto tangents = original_GetAlignedView(proj->views[j].projection.value);
+                        TraceLoggingWriteTagged(local,
+                                                "varjo_EndFrameWithLayers_MultiProj",
+                                                TLArg(j, "ViewIndex"),
+                                                TLArg(-atan(tangents.projectionBottom), "Bottom"),
+                                                TLArg(atan(tangents.projectionTop), "Top"),
+                                                TLArg(-atan(tangents.projectionLeft), "Left"),
+                                                TLArg(atan(tangents.projectionRight), "Right"));
+                    }
+                }
+
+                // Deep copy the projection and views. The stereo layers are expanded to the quad views when the focus
+                // views are synthesized.
+                const bool isSynthesized = currentConfig.synthesizeFocusViews && proj->viewCount == StereoViewCount;
+                auto* const layer = copiesAllocator.Copy(proj);
+                layer->viewCount = isSynthesized ? DefaultViewCount : proj->viewCount;
+                auto* const views = static_cast<varjo_LayerMultiProjView*>(copiesAllocator.Allocate(
+                    sizeof(varjo_LayerMultiProjView) * layer->viewCount, alignof(varjo_LayerMultiProjView)));
+                std::copy_n(proj->views, proj->viewCount, views);
+                for (int32_t k = proj->viewCount; k < layer->viewCount; k++) {
+                    // The placeholder that the applications submit for carving, with the extensions of the stereo
+                    // view (carved below, or passed through).
+                    views[k] = views[ReferenceViews[k]];
+                    views[k].viewport.width = views[k].viewport.height = 1;
+                }
+                layer->views = views;
+                newLayersPtr.push_back(&layer->header);
+
+                // Patch the focus views. The view count is a constant for the quad views, the common case.
+                const auto carveFocusViews = [&](auto viewCount) {
+                    for (int32_t k = StereoViewCount; k < std::min<int32_t>(viewCount, MaxViewCount); k++) {
+                        auto& focusView = views[k];
+                        const auto& referenceView = views[ReferenceViews[k]];
+
+                        // This seems to be how Varjo SDK accepts stereo input.
+                        if (focusView.viewport.width == 1 && focusView.viewport.height == 1) {
+                            const auto fullFovTangents =
+                                original_GetAlignedView(const_cast<double*>(referenceView.projection.value));
+
+                            // Reuse the focus FOV of the previous frame if the stabilized gaze did not move.
+                            auto& geometry = state->focusGeometry[k - StereoViewCount];
+                            const bool isHeld =
+                                hasFrameGaze && geometry.isValid &&
+                                geometry.fovCrop == currentConfig.sizing.fovCrop &&
+                                std::equal(std::begin(geometry.gaze.forward),
+                                           std::end(geometry.gaze.forward),
+                                           std::begin(frameGaze.gaze.forward));
+                            if (!isHeld) {
+                                const double fovCrop = currentConfig.sizing.fovCrop;
+                                geometry.isValid = true;
+                                geometry.gaze = frameGaze.gaze;
+                                geometry.fovCrop = fovCrop;
+
+                                // The geometry is interpolated from the focus grid when there is one, and only the
+                                // projection of a cropped focus FOV is queried.
+                                FocusGrid::Geometry gridGeometry;
+                                const FocusGrid* const grid =
+                                    hasFrameGaze ? LookupFocusGrid(sessionConfig, *state, k, &frameGaze, gridGeometry)
+                                                 : nullptr;
+                                geometry.hasFractions = grid;
+                                if (grid) {
+                                    geometry.tangents = CropFovTangents(gridGeometry.tangents, fovCrop);
+                                    geometry.projection = fovCrop > 0.0
+                                                              ? varjo_GetProjectionMatrix(&geometry.tangents)
+                                                              : gridGeometry.projection;
+                                    geometry.fractions = CropCarveFractions(gridGeometry.fractions, fovCrop);
+                                    geometry.fractionsFullFov = AlignedViewFromTangents(grid->fullFovTangents());
+                                } else {
+                                    geometry.tangents = CropFovTangents(
+                                        GetFovTangents(sessionConfig, *state, k, hasFrameGaze ? &frameGaze : nullptr),
+                                        fovCrop);
+                                    geometry.projection = varjo_GetProjectionMatrix(&geometry.tangents);
+                                }
+                            }
+                            const auto& focusFovTangents = geometry.tangents;
+
+                            // Patch viewport to carve the focus view out of the full view. The carve of the shared
+                            // geometry is used when it applies, so that the processes agree on it to the pixel. The
+                            // carve of the focus grid is used when the full FOV is the one of the grid.
+                            const auto* const sharedGeometry =
+                                state->sharedGeometry[k - StereoViewCount].load(std::memory_order_acquire);
+                            const bool isSharedCarve =
+                                sharedGeometry && IsSharedCarve(*sharedGeometry,
+                                                                fullFovTangents,
+                                                                focusFovTangents,
+                                                                currentConfig.sizing.fovCrop);
+                            const bool isGridCarve =
+                                geometry.hasFractions &&
+                                AlignedViewDistance(geometry.fractionsFullFov, fullFovTangents) <=
+                                    MaxSharedGeometryError;
+                            const auto fractions =
+                                isSharedCarve
+                                    ? CropCarveFractions(sharedGeometry->carveFractions, currentConfig.sizing.fovCrop)
+                                : isGridCarve ? geometry.fractions
+                                              : ComputeCarveFractions(fullFovTangents, focusFovTangents);
+                            if (isSharedCarve) {
+                                stats::g_cacheStats.sharedCarves.fetch_add(1, std::memory_order_relaxed);
+                            }
+                            CarveViewport(
+                                focusView.viewport, referenceView.viewport, fractions, sessionConfig.sizing.alignment);
+
+                            // Carve the extensions (eg: depth, velocity) the same way, for the reprojection of the
+                            // focus view.
+                            auto* const extensions = CarveFocusExtensions(
+                                copiesAllocator,
+                                referenceView.extension,
+                                fractions,
+                                sessionConfig.sizing.alignment,
+                                [&](const ExtensionHandler& handler,
+                                    [[maybe_unused]] const varjo_SwapChainViewport& viewport) {
+                                    carvedExtensions[&handler - ExtensionHandlers]++;
+                                    if (traceVerbose) {
+                                        TraceLoggingWriteTagged(local,
+                                                                "varjo_EndFrameWithLayers_MultiProj_PatchedExtension",
+                                                                TLArg(k, "ViewIndex"),
+                                                                TLArg(handler.name, "Type"),
+                                                                TLPArg(viewport.swapChain, "SwapChain"),
+                                                                TLArg(viewport.arrayIndex, "ArrayIndex"),
+                                                                TLArg(viewport.x, "X"),
+                                                                TLArg(viewport.y, "Y"),
+                                                                TLArg(viewport.width, "Width"),
+                                                                TLArg(viewport.height, "Height"));
+                                    }
+                                });
+                            if (extensions) {
+                                focusView.extension = extensions;
+                            }
+
+                            // Patch to pass the focus FOV.
+                            focusView.projection = geometry.projection;
+
+                            if (traceVerbose) {
+                                TraceLoggingWriteTagged(local,
+                                                        "varjo_EndFrameWithLayers_MultiProj_Patched",
+                                                        TLArg(k, "ViewIndex"),
+                                                        TLPArg(focusView.viewport.swapChain, "SwapChain"),
+                                                        TLArg(focusView.viewport.arrayIndex, "ArrayIndex"),
+                                                        TLArg(focusView.viewport.x, "X"),
+                                                        TLArg(focusView.viewport.y, "Y"),
+                                                        TLArg(focusView.viewport.width, "Width"),
+                                                        TLArg(focusView.viewport.height, "Height"));
+                                TraceLoggingWriteTagged(local,
+                                                        "varjo_EndFrameWithLayers_MultiProj_Patched",
+                                                        TLArg(k, "ViewIndex"),
+                                                        TLArg(atan(focusFovTangents.bottom), "Bottom"),
+                                                        TLArg(atan(focusFovTangents.top), "Top"),
+                                                        TLArg(atan(focusFovTangents.left), "Left"),
+                                                        TLArg(atan(focusFovTangents.right), "Right"));
+                            }
+
+                            stereoPixels += static_cast<uint64_t>(referenceView.viewport.width) *
+                                            referenceView.viewport.height;
+                            focusPixels += static_cast<uint64_t>(focusView.viewport.width) * focusView.viewport.height;
+                            carvedViews++;
+                            heldViews += isHeld;
+
+                            if (sessionConfig.useFoveatedTangents) {
+                                layer->header.flags |= varjo_LayerFlag_Foveated;
+                            }
+                        }
+                    }
+                };
+                if (layer->viewCount == DefaultViewCount) {
+                    carveFocusViews(std::integral_constant<int32_t, DefaultViewCount>{});
+                } else {
+                    carveFocusViews(layer->viewCount);
+                }
+                if (isSynthesized) {
+                    synthesizedViews += DefaultViewCount - StereoViewCount;
+                }
+            } else {
+                // Other layers are passed through.
+                newLayersPtr.push_back(submitInfo->layers[i]);
+            }
+        }
+        newSubmitInfo.layers = newLayersPtr.data();
+
+        for (auto* frameStats : {&state->frameStats, &stats::g_frameStats}) {
+            frameStats->stereoPixels.store(stereoPixels, std::memory_order_relaxed);
+            frameStats->focusPixels.store(focusPixels, std::memory_order_relaxed);
+            frameStats->carvedViews.store(carvedViews, std::memory_order_relaxed);
+            frameStats->heldViews.store(heldViews, std::memory_order_relaxed);
+            frameStats->synthesizedViews.store(synthesizedViews, std::memory_order_relaxed);
+            for (size_t i = 0; i < ExtensionHandlerCount; i++) {
+                if (const auto carvedCount = ExtensionHandlers[i].carvedCount) {
+                    (frameStats->*carvedCount).store(carvedExtensions[i], std::memory_order_relaxed);
+                }
+            }
+        }
+
+        original_EndFrameWithLayers(session, &newSubmitInfo);
+
+        TraceLoggingWriteStop(local, "varjo_EndFrameWithLayers");
+    }
+
+    // Control channel command: sweep one word of the foveation hints in the current session, and report the focus
+    // region and carving that each value would produce (with a forward gaze).
+    std::string SweepFoveationHints(const std::vector<std::string>& args) {
+        if (args.size() != 2) {
+            return "error: usage: hints <index> <value>[,<value>...]\n";
+        }
+        const auto state = g_sessions.Find(g_lastSession.load(std::memory_order_acquire));
+        if (!state) {
+            return "error: no session\n";
+        }
+
+        varjo_Session* const session = state->session;
+        const Config& sessionConfig = state->config;
+        if (!sessionConfig.useFoveatedTangents) {
+            return "error: the hints are only used with the foveated tangents\n";
+        }
+
+        constexpr double DegreesPerRadian = 180.0 / 3.14159265358979323846;
+        Config config = sessionConfig;
+        varjo_Gaze gaze;
+        GetForwardGaze(&gaze);
+        std::string result =
+            "value,view,focus_h_deg,focus_v_deg,stereo_width,stereo_height,carved_width,carved_height\n";
+        std::istringstream values(args[1]);
+        for (std::string value; std::getline(values, value, ',');) {
+            config.foveationHints = sessionConfig.foveationHints;
+            if (!config::ParseFoveationHints(args[0] + ":" + value, config.foveationHints)) {
+                return "error: invalid hint " + args[0] + ":" + value + "\n";
+            }
+
+            for (int32_t viewIndex = 0; viewIndex < StereoViewCount; viewIndex++) {
+                int32_t width, height;
+                original_GetTextureSize(
+                    session, varjo_TextureSize_Type_DynamicFoveation, StereoViewCount + viewIndex, &width, &height);
+                const auto fullFovTangents = GetFovTangents(config, *state, viewIndex, &gaze);
+                const auto focusFovTangents = GetFovTangents(config, *state, StereoViewCount + viewIndex, &gaze);
+                ComputeStereoTextureSize(
+                    ComputeTextureMultipliers(fullFovTangents, focusFovTangents), config.sizing, &width, &height);
+                const auto fractions =
+                    ComputeCarveFractions(AlignedViewFromTangents(fullFovTangents),
+                                          CropFovTangents(focusFovTangents, config.sizing.fovCrop));
+
+                char buf[256];
+                snprintf(buf,
+                         sizeof(buf),
+                         "%s,%d,%.2f,%.2f,%d,%d,%u,%u\n",
+                         value.c_str(),
+                         viewIndex,
+                         (atan(focusFovTangents.right) - atan(focusFovTangents.left)) * DegreesPerRadian,
+                         (atan(focusFovTangents.top) - atan(focusFovTangents.bottom)) * DegreesPerRadian,
+                         width,
+                         height,
+                         AlignTo(static_cast<uint32_t>(fractions.width * width), config.sizing.alignment),
+                         AlignTo(static_cast<uint32_t>(fractions.height * height), config.sizing.alignment));
+                result += buf;
+            }
+        }
+        return result;
+    }
+
+    // Control channel command: the statistics of the last frame of each session.
+    std::string DescribeSessions([[maybe_unused]] const std::vector<std::string>& args) {
+        std::string result;
+        g_sessions.ForEach([&](varjo_Session* session, const SessionState& state) {
+            char buf[64];
+            snprintf(buf, sizeof(buf), "%p: ", static_cast<void*>(session));
+            result += buf + stats::FormatFrame(state.frameStats);
+        });
+        return result.empty() ? "no session\n" : result;
+    }
+
+    // Control channel command: the geometry records shared between the processes.
+    std::string DescribeSharedGeometry([[maybe_unused]] const std::vector<std::string>& args) {
+        if (!g_sharedGeometry.IsOpen()) {
+            return "error: the geometry is not shared\n";
+        }
+
+        constexpr double DegreesPerRadian = 180.0 / 3.14159265358979323846;
+        std::string result = "key,full_h_deg,full_v_deg,focus_h_deg,focus_v_deg,h_multiplier,v_multiplier,carve_x,"
+                             "carve_y,carve_width,carve_height,grid_nodes\n";
+        g_sharedGeometry.ForEach([&](uint64_t key, const shared::ViewGeometry& geometry) {
+            const auto& full = geometry.fullFovTangents;
+            const auto& focus = geometry.focusFovTangents;
+            char buf[256];
+            snprintf(buf,
+                     sizeof(buf),
+                     "%016llx,%.2f,%.2f,%.2f,%.2f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%zu\n",
+                     static_cast<unsigned long long>(key),
+                     (atan(full.right) - atan(full.left)) * DegreesPerRadian,
+                     (atan(full.top) - atan(full.bottom)) * DegreesPerRadian,
+                     (atan(focus.right) - atan(focus.left)) * DegreesPerRadian,
+                     (atan(focus.top) - atan(focus.bottom)) * DegreesPerRadian,
+                     geometry.multipliers.horizontal,
+                     geometry.multipliers.vertical,
+                     geometry.carveFractions.x,
+                     geometry.carveFractions.y,
+                     geometry.carveFractions.width,
+                     geometry.carveFractions.height,
+                     geometry.gridNodes.size());
+            result += buf;
+        });
+        return result;
+    }
+
+    void (*original_SessionShutDown)(struct varjo_Session* session) = nullptr;
+    void hooked_SessionShutDown(struct varjo_Session* session) {
+        EnsureInitialized();
+        TraceLocalActivity(local);
+        TraceLoggingWriteStart(local, "varjo_SessionShutDown", TLPArg(session, "Session"));
+
+        // The poller must not outlive the session.
+        if (const auto state = g_sessions.Find(session)) {
+            StopGazePoller(*state);
+        }
+
+        // Wait for the other hooks to be done with the state (eg: the control channel) before the runtime destroys
+        // the session, since they may still be calling the runtime with it.
+        g_sessions.Remove(session);
+
+        original_SessionShutDown(session);
+
+        TraceLoggingWriteStop(local, "varjo_SessionShutDown");
+    }
+
+} // namespace
+
+namespace quadinator::hooks {
+
+    void SetProcessInfo(const std::filesystem::path& dllRoot, const std::string& executableName) {
+        g_dllRoot = dllRoot;
+        g_executableName = executableName;
+    }
+
+    void SetDeferredInitialization(void (*initialize)()) {
+        g_deferredInitialization = initialize;
+    }
+
+    bool Attach(void* module, bool isVarjoRuntime) {
+        // clang-format off
+        using interpose::Hook;
+        using interpose::Resolve;
+        interpose::HookEntry entries[] = {
+            Resolve("varjo_GetAlignedView",
+                    "struct_varjo_AlignedViewvarjo_GetAlignedViewdoubleP",
+                    original_GetAlignedView),
+            Resolve("varjo_GetFovTangents",
+                    "varjo_FovTangentsvarjo_GetFovTangentsstruct_varjo_SessionPint32_t",
+                    original_GetFovTangents),
+            Resolve("varjo_GetFoveatedFovTangents",
+                    "varjo_FovTangentsvarjo_GetFoveatedFovTangentsstruct_varjo_SessionPint32_tstruct_varjo_GazePstruct_varjo_FoveatedFovTangents_HintsP",
+                    original_GetFoveatedFovTangents),
+            Resolve("varjo_GetRenderingGaze",
+                    "varjo_Boolvarjo_GetRenderingGazestruct_varjo_SessionPstruct_varjo_GazeP",
+                    original_GetRenderingGaze),
+            // Optional: without it, the gaze is predicted with the configured latency instead.
+            Resolve("varjo_FrameGetDisplayTime",
+                    "varjo_Nanosecondsvarjo_FrameGetDisplayTimestruct_varjo_SessionP",
+                    original_FrameGetDisplayTime,
+                    true /* isOptional */),
+            // Optional: without it, the quad views are assumed.
+            Resolve("varjo_GetViewCount",
+                    "int32_tvarjo_GetViewCountstruct_varjo_SessionP",
+                    original_GetViewCount,
+                    true /* isOptional */),
+            Hook("varjo_GetTextureSize",
+                 "voidvarjo_GetTextureSizestruct_varjo_SessionPvarjo_TextureSize_Typeint32_tint32_tPint32_tP",
+                 hooked_GetTextureSize,
+                 original_GetTextureSize),
+            Hook("varjo_GetViewDescription",
+                 "struct_varjo_ViewDescriptionvarjo_GetViewDescriptionstruct_varjo_SessionPint32_t",
+                 hooked_GetViewDescription,
+                 original_GetViewDescription),
+            // The legacy varjo_EndFrame() is not hooked: the clients of the patched libraries (the Varjo OpenXR
+            // runtime and vrserver.exe) submit their frames with the layers.
+            Hook("varjo_EndFrameWithLayers",
+                 "voidvarjo_EndFrameWithLayersstruct_varjo_SessionPstruct_varjo_SubmitInfoLayersP",
+                 hooked_EndFrameWithLayers,
+                 original_EndFrameWithLayers),
+            Hook("varjo_SessionShutDown",
+                 "voidvarjo_SessionShutDownstruct_varjo_SessionP",
+                 hooked_SessionShutDown,
+                 original_SessionShutDown),
+        };
+        // clang-format on
+        return interpose::Attach(module, isVarjoRuntime, entries);
+    }
+
+} // namespace quadinator::hooks
@@ -0,0 +1,45 @@
+// MIT License
+//
+// Copyright(c) 2023 Matthieu Bucchianeri
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this softwareand associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright noticeand this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+// The hooks of the Varjo library entry points.
+
+#include <filesystem>
+#include <string>
+
+namespace quadinator::hooks {
+
+    // Record where the DLL is, and which application it is loaded into. Must be called before the first call to a
+    // hook, either before Attach() or from the deferred initialization.
+    void SetProcessInfo(const std::filesystem::path& dllRoot, const std::string& executableName);
+
+    // Work to run upon the first call to a hook, before the rest of the initialization (configuration, control
+    // channel). Attach() may run under the loader lock, where this work is not allowed (eg: file system access).
+    void SetDeferredInitialization(void (*initialize)());
+
+    // Resolve the entry points of the Varjo library module and attach the hooks, all at once (see
+    // interpose::Attach()). The runtime (VarjoRuntime.dll) exports mangled names.
+    bool Attach(void* module, bool isVarjoRuntime);
+
+} // namespace quadinator::hooks
@@ -0,0 +1,212 @@
+// MIT License
+//
+// Copyright(c) 2023 Matthieu Bucchianeri
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this softwareand associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright noticeand this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <detours.h>
+#include <psapi.h>
+#else
+#include <dlfcn.h>
+#endif
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "interpose.h"
+#include "pe.h"
+#include "tracing.h"
+
+namespace {
+
+    using namespace quadinator;
+    using namespace quadinator::interpose;
+
+    std::vector<std::string_view> GetNames(bool useRuntimeNames, const HookEntry* entries, size_t count) {
+        std::vector<std::string_view> names;
+        for (size_t i = 0; i < count; i++) {
+            names.push_back(!useRuntimeNames ? entries[i].name : entries[i].runtimeName);
+        }
+        return names;
+    }
+
+    // Resolve the entry points, and report whether all the required ones were found.
+    bool ResolveAll(const std::vector<void*>& addresses,
+                    const std::vector<std::string_view>& names,
+                    HookEntry* entries) {
+        bool ok = true;
+        for (size_t i = 0; i < names.size(); i++) {
+            *entries[i].original = addresses[i];
+            if (!addresses[i] && !entries[i].isOptional) {
+                TraceLoggingWrite(g_traceProvider, "InstallHooks_Missing", TLArg(names[i].data(), "Name"));
+                ok = false;
+            }
+        }
+        return ok;
+    }
+
+    void Reset(HookEntry* entries, size_t count) {
+        for (size_t i = 0; i < count; i++) {
+            *entries[i].original = nullptr;
+        }
+    }
+
+#ifdef _WIN32
+    std::vector<void*> ResolveExports(HMODULE module, const std::vector<std::string_view>& names) {
+        // The entry points are resolved from the export directory of the mapped image (plain memory reads).
+        MODULEINFO moduleInfo{};
+        pe::ExportTable exportTable;
+        const bool isParsed =
+            GetModuleInformation(GetCurrentProcess(), module, &moduleInfo, sizeof(moduleInfo)) &&
+            exportTable.Parse(module, moduleInfo.SizeOfImage, pe::ImageLayout::Mapped);
+
+        std::vector<void*> addresses;
+        for (const auto& name : names) {
+            const pe::ExportResult result = isParsed ? exportTable.Find(name) : pe::ExportResult{};
+            if (result.status == pe::ExportStatus::Resolved) {
+                addresses.push_back(reinterpret_cast<uint8_t*>(module) + result.rva);
+            } else if (result.status == pe::ExportStatus::Forwarded || !isParsed) {
+                // Forwarded exports (or an unexpected image) are left to the OS loader.
+                addresses.push_back(reinterpret_cast<void*>(GetProcAddress(module, name.data())));
+            } else {
+                // Reported by ResolveAll() if required.
+                addresses.push_back(nullptr);
+            }
+            TraceLoggingWrite(g_traceProvider,
+                              "InstallHooks_Resolve",
+                              TLArg(name.data(), "Name"),
+                              TLArg(static_cast<int>(result.status), "ExportStatus"),
+                              TLPArg(addresses.back(), "Address"));
+        }
+        return addresses;
+    }
+#else
+    // The dispatch table slot of an entry point.
+    std::atomic<void*>* GetDispatchSlot(void* module, std::string_view name) {
+        const std::string symbol = std::string(name) + "_dispatch";
+        return static_cast<std::atomic<void*>*>(dlsym(module ? module : RTLD_DEFAULT, symbol.c_str()));
+    }
+#endif
+
+} // namespace
+
+namespace quadinator::interpose {
+
+#ifdef _WIN32
+    void Initialize() {
+        DetourRestoreAfterWith();
+    }
+
+    bool Attach(void* module, bool useRuntimeNames, HookEntry* entries, size_t count) {
+        const auto names = GetNames(useRuntimeNames, entries, count);
+        bool ok = ResolveAll(ResolveExports(static_cast<HMODULE>(module), names), names, entries);
+
+        if (ok) {
+            DetourTransactionBegin();
+            DetourUpdateThread(GetCurrentThread());
+            for (size_t i = 0; i < count; i++) {
+                if (entries[i].hooked) {
+                    const LONG error = DetourAttach(entries[i].original, entries[i].hooked);
+                    TraceLoggingWrite(
+                        g_traceProvider, "InstallHooks_Attach", TLArg(names[i].data(), "Name"), TLArg(error, "Error"));
+                    ok = ok && error == NO_ERROR;
+                }
+            }
+            if (ok) {
+                const LONG error = DetourTransactionCommit();
+                TraceLoggingWrite(g_traceProvider, "InstallHooks_Commit", TLArg(error, "Error"));
+                ok = error == NO_ERROR;
+            } else {
+                DetourTransactionAbort();
+            }
+        }
+
+        if (!ok) {
+            Reset(entries, count);
+        }
+        return ok;
+    }
+
+    void Detach(void* module, bool useRuntimeNames, HookEntry* entries, size_t count) {
+        DetourTransactionBegin();
+        DetourUpdateThread(GetCurrentThread());
+        for (size_t i = 0; i < count; i++) {
+            if (entries[i].hooked && *entries[i].original) {
+                DetourDetach(entries[i].original, entries[i].hooked);
+            }
+        }
+        DetourTransactionCommit();
+        Reset(entries, count);
+    }
+#else
+    void Initialize() {
+    }
+
+    bool Attach(void* module, bool useRuntimeNames, HookEntry* entries, size_t count) {
+        const auto names = GetNames(useRuntimeNames, entries, count);
+
+        // The entry points of the hooks are their dispatch table slots, which are swapped all at once below.
+        std::vector<void*> addresses;
+        std::vector<std::atomic<void*>*> slots;
+        for (size_t i = 0; i < count; i++) {
+            auto* slot = entries[i].hooked ? GetDispatchSlot(module, names[i]) : nullptr;
+            slots.push_back(slot);
+            if (entries[i].hooked) {
+                addresses.push_back(slot ? slot->load() : nullptr);
+            } else {
+                addresses.push_back(dlsym(module ? module : RTLD_NEXT, names[i].data()));
+            }
+        }
+        if (!ResolveAll(addresses, names, entries)) {
+            Reset(entries, count);
+            return false;
+        }
+
+        for (size_t i = 0; i < count; i++) {
+            if (slots[i]) {
+                slots[i]->store(entries[i].hooked);
+            }
+        }
+        return true;
+    }
+
+    void Detach(void* module, bool useRuntimeNames, HookEntry* entries, size_t count) {
+        const auto names = GetNames(useRuntimeNames, entries, count);
+        for (size_t i = 0; i < count; i++) {
+            if (!entries[i].hooked || !*entries[i].original) {
+                continue;
+            }
+            if (auto* slot = GetDispatchSlot(module, names[i])) {
+                // Only restore the slot if it was not swapped again since.
+                void* expected = entries[i].hooked;
+                slot->compare_exchange_strong(expected, *entries[i].original);
+            }
+        }
+        Reset(entries, count);
+    }
+#endif
+
+} // namespace quadinator::interpose
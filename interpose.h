@@ -0,0 +1,79 @@
+// MIT License
+//
+// Copyright(c) 2023 Matthieu Bucchianeri
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this softwareand associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright noticeand this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+// Interposition of the Varjo library entry points. Detours is used on Windows. On other platforms, the entry points
+// are resolved with dlsym(), and the hooks are installed by swapping the slots of the dispatch table of the library
+// (a stand-in runtime exporting a "<name>_dispatch" function pointer for each entry point that it routes through it).
+
+#include <cstddef>
+
+namespace quadinator::interpose {
+
+    // An entry point of the Varjo library, resolved and optionally hooked.
+    struct HookEntry {
+        // Export name in VarjoLib.dll, and mangled export name in VarjoRuntime.dll.
+        const char* name;
+        const char* runtimeName;
+
+        // The hook to attach, or nullptr to only resolve the entry point.
+        void* hooked;
+        void** original;
+
+        // Whether the entry point can be missing.
+        bool isOptional;
+    };
+
+    template <typename TMethod>
+    HookEntry Hook(const char* name, const char* runtimeName, TMethod hooked, TMethod& original) {
+        return {name, runtimeName, reinterpret_cast<void*>(hooked), reinterpret_cast<void**>(&original), false};
+    }
+
+    template <typename TMethod>
+    HookEntry Resolve(const char* name, const char* runtimeName, TMethod& original, bool isOptional = false) {
+        return {name, runtimeName, nullptr, reinterpret_cast<void**>(&original), isOptional};
+    }
+
+    // Must be called first when the process starts (or the library is loaded).
+    void Initialize();
+
+    // Resolve all the entry points from the module and attach all the hooks at once. The hooks depend on each
+    // other, so either all of them are attached, or none (if an entry point is missing or an attach fails). On other
+    // platforms than Windows, a null module resolves the entry points with RTLD_NEXT.
+    bool Attach(void* module, bool useRuntimeNames, HookEntry* entries, size_t count);
+
+    template <size_t Count>
+    bool Attach(void* module, bool useRuntimeNames, HookEntry (&entries)[Count]) {
+        return Attach(module, useRuntimeNames, entries, Count);
+    }
+
+    // Restore the entry points attached with Attach(). Must not be called while a hook is executing.
+    void Detach(void* module, bool useRuntimeNames, HookEntry* entries, size_t count);
+
+    template <size_t Count>
+    void Detach(void* module, bool useRuntimeNames, HookEntry (&entries)[Count]) {
+        Detach(module, useRuntimeNames, entries, Count);
+    }
+
+} // namespace quadinator::interpose
@@ -0,0 +1,198 @@
+// MIT License
+//
+// Copyright(c) 2023 Matthieu Bucchianeri
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this softwareand associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright noticeand this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <algorithm>
+#include <cstring>
+
+#include "pe.h"
+
+namespace {
+
+    // Offsets in the PE headers (see the PE/COFF specification).
+    constexpr size_t DosNewHeaderOffset = 0x3c;
+    constexpr size_t FileHeaderSize = 20;
+    constexpr size_t OptionalHeaderDirectoriesPE32 = 96;
+    constexpr size_t OptionalHeaderDirectoriesPE32Plus = 112;
+    constexpr size_t SectionHeaderSize = 40;
+    constexpr size_t ExportDirectorySize = 40;
+    constexpr uint16_t MagicPE32 = 0x10b;
+    constexpr uint16_t MagicPE32Plus = 0x20b;
+
+    template <typename T>
+    T Read(const uint8_t* p) {
+        // PE images are little-endian, like all the platforms we run on.
+        T value;
+        memcpy(&value, p, sizeof(value));
+        return value;
+    }
+
+} // namespace
+
+namespace quadinator::pe {
+
+    bool ExportTable::Parse(const void* image, size_t size, ImageLayout layout) {
+        *this = {};
+        m_image = static_cast<const uint8_t*>(image);
+        m_size = size;
+        m_layout = layout;
+
+        if (size < DosNewHeaderOffset + 4 || memcmp(m_image, "MZ", 2)) {
+            return false;
+        }
+        const size_t ntHeaders = Read<uint32_t>(m_image + DosNewHeaderOffset);
+        if (ntHeaders > size || size - ntHeaders < 4 + FileHeaderSize + 2 || memcmp(m_image + ntHeaders, "PE\0\0", 4)) {
+            return false;
+        }
+
+        const uint8_t* fileHeader = m_image + ntHeaders + 4;
+        const uint16_t numberOfSections = Read<uint16_t>(fileHeader + 2);
+        const uint16_t sizeOfOptionalHeader = Read<uint16_t>(fileHeader + 16);
+        const size_t optionalHeader = ntHeaders + 4 + FileHeaderSize;
+        const size_t sections = optionalHeader + sizeOfOptionalHeader;
+        if (sections > size || (size - sections) / SectionHeaderSize < numberOfSections) {
+            return false;
+        }
+        m_sections = m_image + sections;
+        m_numberOfSections = numberOfSections;
+
+        const uint16_t magic = Read<uint16_t>(m_image + optionalHeader);
+        size_t directories;
+        if (magic == MagicPE32) {
+            directories = OptionalHeaderDirectoriesPE32;
+        } else if (magic == MagicPE32Plus) {
+            directories = OptionalHeaderDirectoriesPE32Plus;
+        } else {
+            return false;
+        }
+        if (sizeOfOptionalHeader < directories) {
+            return false;
+        }
+        const uint32_t numberOfDirectories = Read<uint32_t>(m_image + optionalHeader + directories - 4);
+        if (numberOfDirectories == 0 || sizeOfOptionalHeader < directories + 8) {
+            // No export directory.
+            return true;
+        }
+
+        m_exportRva = Read<uint32_t>(m_image + optionalHeader + directories);
+        m_exportSize = Read<uint32_t>(m_image + optionalHeader + directories + 4);
+        if (!m_exportRva) {
+            return true;
+        }
+
+        const uint8_t* directory = At(m_exportRva, ExportDirectorySize);
+        if (!directory) {
+            return false;
+        }
+        m_numberOfFunctions = Read<uint32_t>(directory + 20);
+        m_numberOfNames = Read<uint32_t>(directory + 24);
+        m_functions = At(Read<uint32_t>(directory + 28), size_t{m_numberOfFunctions} * 4);
+        m_names = At(Read<uint32_t>(directory + 32), size_t{m_numberOfNames} * 4);
+        m_ordinals = At(Read<uint32_t>(directory + 36), size_t{m_numberOfNames} * 2);
+        if ((m_numberOfFunctions && !m_functions) || (m_numberOfNames && (!m_names || !m_ordinals))) {
+            m_numberOfFunctions = m_numberOfNames = 0;
+            return false;
+        }
+
+        return true;
+    }
+
+    const uint8_t* ExportTable::Locate(uint32_t rva, size_t& available) const {
+        size_t offset = rva;
+        size_t limit = m_size;
+        if (m_layout == ImageLayout::File) {
+            // Find the section containing the RVA, and stay within its raw data.
+            limit = 0;
+            for (uint16_t i = 0; i < m_numberOfSections; i++) {
+                const uint8_t* section = m_sections + i * SectionHeaderSize;
+                const uint32_t virtualAddress = Read<uint32_t>(section + 12);
+                const uint32_t sizeOfRawData = Read<uint32_t>(section + 16);
+                const uint32_t pointerToRawData = Read<uint32_t>(section + 20);
+                if (rva >= virtualAddress && rva - virtualAddress < sizeOfRawData) {
+                    offset = size_t{pointerToRawData} + (rva - virtualAddress);
+                    limit = std::min(m_size, size_t{pointerToRawData} + sizeOfRawData);
+                    break;
+                }
+            }
+        }
+        if (offset >= limit) {
+            available = 0;
+            return nullptr;
+        }
+        available = limit - offset;
+        return m_image + offset;
+    }
+
+    const uint8_t* ExportTable::At(uint32_t rva, size_t length) const {
+        size_t available;
+        const uint8_t* p = Locate(rva, available);
+        return p && available >= length ? p : nullptr;
+    }
+
+    std::string_view ExportTable::name(uint32_t index) const {
+        if (index >= m_numberOfNames) {
+            return {};
+        }
+        const uint32_t rva = Read<uint32_t>(m_names + size_t{index} * 4);
+        size_t available;
+        const auto* start = reinterpret_cast<const char*>(Locate(rva, available));
+        if (!start) {
+            return {};
+        }
+        // The name must be terminated within the image.
+        const auto* end = static_cast<const char*>(memchr(start, 0, available));
+        return end ? std::string_view(start, end - start) : std::string_view();
+    }
+
+    ExportResult ExportTable::Export(uint16_t ordinal) const {
+        if (ordinal >= m_numberOfFunctions) {
+            return {};
+        }
+        const uint32_t rva = Read<uint32_t>(m_functions + size_t{ordinal} * 4);
+        if (!rva) {
+            return {};
+        }
+        // Forwarders are strings in the export directory.
+        if (rva >= m_exportRva && rva - m_exportRva < m_exportSize) {
+            return {ExportStatus::Forwarded, rva};
+        }
+        return {ExportStatus::Resolved, rva};
+    }
+
+    ExportResult ExportTable::Find(std::string_view name) const {
+        uint32_t low = 0;
+        uint32_t high = m_numberOfNames;
+        while (low < high) {
+            const uint32_t middle = low + (high - low) / 2;
+            const int comparison = this->name(middle).compare(name);
+            if (comparison == 0) {
+                return Export(Read<uint16_t>(m_ordinals + size_t{middle} * 2));
+            } else if (comparison < 0) {
+                low = middle + 1;
+            } else {
+                high = middle;
+            }
+        }
+        return {};
+    }
+
+} // namespace quadinator::pe
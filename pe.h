@@ -0,0 +1,98 @@
+// MIT License
+//
+// Copyright(c) 2023 Matthieu Bucchianeri
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this softwareand associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright noticeand this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+// Resolution of the exports of a PE image, shared between the DLL hooks and the offline tools.
+// This header must remain portable (no Windows or Detours dependencies).
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace quadinator::pe {
+
+    enum class ImageLayout {
+        // The image is loaded by the OS loader (eg: an HMODULE): RVAs are offsets from the base.
+        Mapped,
+
+        // The image is read from disk: RVAs must be translated through the section table.
+        File,
+    };
+
+    enum class ExportStatus {
+        Missing,
+        Resolved,
+
+        // The export is forwarded to another module, and must be resolved by the OS loader.
+        Forwarded,
+    };
+
+    struct ExportResult {
+        ExportStatus status{ExportStatus::Missing};
+        uint32_t rva{0};
+    };
+
+    // A view of the export directory of a PE image. The image must outlive the table.
+    class ExportTable {
+      public:
+        // Validate the headers and locate the export directory. Every read is bounds-checked against size. An image
+        // without an export directory is valid, and has no exports.
+        bool Parse(const void* image, size_t size, ImageLayout layout);
+
+        // Resolve one name by binary search of the (sorted) export names, like GetProcAddress() does.
+        ExportResult Find(std::string_view name) const;
+
+        uint32_t count() const {
+            return m_numberOfNames;
+        }
+
+        // The name of an export, or an empty view if it is out of the image.
+        std::string_view name(uint32_t index) const;
+
+        // Translate an RVA into a pointer in the image, or nullptr if the range [rva, rva + length) is out of it.
+        const uint8_t* At(uint32_t rva, size_t length) const;
+
+      private:
+        // Translate an RVA into a pointer in the image, and the number of bytes readable from it.
+        const uint8_t* Locate(uint32_t rva, size_t& available) const;
+
+        ExportResult Export(uint16_t ordinal) const;
+
+        const uint8_t* m_image{nullptr};
+        size_t m_size{0};
+        ImageLayout m_layout{ImageLayout::Mapped};
+
+        const uint8_t* m_sections{nullptr};
+        uint16_t m_numberOfSections{0};
+
+        uint32_t m_exportRva{0};
+        uint32_t m_exportSize{0};
+        uint32_t m_numberOfFunctions{0};
+        uint32_t m_numberOfNames{0};
+        const uint8_t* m_functions{nullptr};
+        const uint8_t* m_names{nullptr};
+        const uint8_t* m_ordinals{nullptr};
+    };
+
+} // namespace quadinator::pe
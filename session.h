@@ -0,0 +1,213 @@
+// MIT License
+//
+// Copyright(c) 2023 Matthieu Bucchianeri
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this softwareand associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright noticeand this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+// Per-session state, shared between the DLL hooks and the offline tools.
+// This header must remain portable (no Windows or Detours dependencies).
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <Varjo_types.h>
+
+namespace quadinator {
+
+    // A map from the sessions to their state, for a process serving several sessions at once (eg: vrserver.exe).
+    //
+    // The map is read on every hook call and only modified when a session starts or ends. Readers look the session
+    // up in an immutable snapshot of the map, without locking. Writers publish a new snapshot under a lock. Removed
+    // states and retired snapshots are deleted once no reader can still see them: readers register in one of two
+    // reader counts, and the writer waits for both counts to drain in turn (like sleepable RCU).
+    //
+    // The states are constructed from their session (State(varjo_Session*)).
+    template <typename State>
+    class SessionMap {
+      public:
+        // A reference to the state of a session, valid for the lifetime of the lease.
+        class Lease {
+          public:
+            Lease(Lease&& other) noexcept
+                : m_map(std::exchange(other.m_map, nullptr)), m_epoch(other.m_epoch), m_state(other.m_state) {
+            }
+            Lease(const Lease&) = delete;
+            Lease& operator=(const Lease&) = delete;
+            Lease& operator=(Lease&&) = delete;
+
+            ~Lease() {
+                if (m_map) {
+                    m_map->m_readers[m_epoch].fetch_sub(1, std::memory_order_release);
+                }
+            }
+
+            explicit operator bool() const {
+                return m_state;
+            }
+            State* operator->() const {
+                return m_state;
+            }
+            State& operator*() const {
+                return *m_state;
+            }
+
+          private:
+            friend class SessionMap;
+
+            explicit Lease(const SessionMap* map) : m_map(map) {
+                m_epoch = m_map->m_epoch.load(std::memory_order_relaxed) & 1;
+                // Sequentially consistent, so that the snapshot is loaded after the reader registered.
+                m_map->m_readers[m_epoch].fetch_add(1, std::memory_order_seq_cst);
+            }
+
+            const SessionMap* m_map;
+            uint64_t m_epoch{0};
+            State* m_state{nullptr};
+        };
+
+        SessionMap() : m_snapshot(new Snapshot) {
+        }
+
+        ~SessionMap() {
+            const Snapshot* snapshot = m_snapshot.load(std::memory_order_relaxed);
+            for (const auto& entry : *snapshot) {
+                delete entry.second;
+            }
+            delete snapshot;
+            for (const Snapshot* retired : m_retired) {
+                delete retired;
+            }
+        }
+
+        // The state of the session, created on first use.
+        Lease Acquire(varjo_Session* session) {
+            Lease lease(this);
+            lease.m_state = Lookup(session);
+            if (!lease.m_state) {
+                lease.m_state = Insert(session);
+            }
+            return lease;
+        }
+
+        // The state of the session, or an empty lease if the session has no state.
+        Lease Find(varjo_Session* session) const {
+            Lease lease(this);
+            lease.m_state = Lookup(session);
+            return lease;
+        }
+
+        // Invoke func(session, state) for each session, within a single lease.
+        template <typename Func>
+        void ForEach(Func func) const {
+            Lease lease(this);
+            for (const auto& entry : *m_snapshot.load(std::memory_order_seq_cst)) {
+                func(entry.first, *entry.second);
+            }
+        }
+
+        // Remove the session, and delete its state once no reader can still use it. Must not be called while holding
+        // a lease, which would never drain.
+        void Remove(varjo_Session* session) {
+            State* state;
+            std::vector<const Snapshot*> retired;
+            {
+                std::unique_lock lock(m_mutex);
+                const Snapshot* snapshot = m_snapshot.load(std::memory_order_relaxed);
+                const auto it = std::find_if(
+                    snapshot->cbegin(), snapshot->cend(), [&](const auto& entry) { return entry.first == session; });
+                if (it == snapshot->cend()) {
+                    return;
+                }
+
+                state = it->second;
+                auto* newSnapshot = new Snapshot(*snapshot);
+                newSnapshot->erase(newSnapshot->begin() + (it - snapshot->cbegin()));
+                m_snapshot.store(newSnapshot, std::memory_order_seq_cst);
+                m_retired.push_back(snapshot);
+                retired.swap(m_retired);
+            }
+
+            // Not under the lock, since a reader may be waiting for it to create a state.
+            Synchronize();
+            delete state;
+            for (const Snapshot* snapshot : retired) {
+                delete snapshot;
+            }
+        }
+
+      private:
+        // Few sessions exist at once: a linear search is the fastest lookup.
+        using Snapshot = std::vector<std::pair<varjo_Session*, State*>>;
+
+        State* Lookup(varjo_Session* session) const {
+            for (const auto& entry : *m_snapshot.load(std::memory_order_seq_cst)) {
+                if (entry.first == session) {
+                    return entry.second;
+                }
+            }
+            return nullptr;
+        }
+
+        State* Insert(varjo_Session* session) {
+            std::unique_lock lock(m_mutex);
+            // Another thread may have created the state since the lookup.
+            if (State* state = Lookup(session)) {
+                return state;
+            }
+
+            const Snapshot* snapshot = m_snapshot.load(std::memory_order_relaxed);
+            auto* newSnapshot = new Snapshot(*snapshot);
+            State* state = new State(session);
+            newSnapshot->emplace_back(session, state);
+            m_snapshot.store(newSnapshot, std::memory_order_seq_cst);
+            // Deleted on the next removal.
+            m_retired.push_back(snapshot);
+            return state;
+        }
+
+        // Wait until every reader that may have loaded a previous snapshot is gone. Readers are counted in the parity
+        // of the epoch they observed. Draining the count of each parity after a flip guarantees that every reader that
+        // registered before the new snapshot was published has left, and that any reader registered since then
+        // loaded the new snapshot.
+        void Synchronize() {
+            for (int i = 0; i < 2; i++) {
+                const uint64_t epoch = m_epoch.fetch_add(1, std::memory_order_seq_cst) & 1;
+                while (m_readers[epoch].load(std::memory_order_acquire)) {
+                    std::this_thread::yield();
+                }
+            }
+        }
+
+        std::atomic<const Snapshot*> m_snapshot;
+        mutable std::atomic<uint64_t> m_epoch{0};
+        mutable std::atomic<uint64_t> m_readers[2]{};
+
+        std::mutex m_mutex;
+        std::vector<const Snapshot*> m_retired;
+    };
+
+} // namespace quadinator
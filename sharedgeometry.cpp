@@ -0,0 +1,396 @@
+// MIT License
+//
+// Copyright(c) 2023 Matthieu Bucchianeri
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this softwareand associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright noticeand this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <initializer_list>
+#include <thread>
+
+#include "sharedgeometry.h"
+
+namespace quadinator::shared {
+
+    namespace {
+
+        // The segment is mapped at a different address in each process: only lock-free (address-free) atomics may
+        // live in it.
+        static_assert(std::atomic<uint32_t>::is_always_lock_free && std::atomic<uint64_t>::is_always_lock_free);
+        static_assert(sizeof(varjo_FovTangents) == 4 * sizeof(double));
+
+        constexpr size_t SlotCount = 16;
+
+        // The header is followed by the slots, on their own cache line.
+        constexpr size_t SlotsOffset = 64;
+
+        // fullFovTangents, focusFovTangents, multipliers, carveFractions and the number of grid nodes.
+        constexpr size_t FixedWords = 4 + 4 + 2 + 4 + 1;
+        constexpr size_t SlotWords = FixedWords + 4 * MaxGridNodes;
+
+        // A reader racing with a writer retries a few times, then gives up.
+        constexpr int ReadAttempts = 4;
+
+        // How long to wait for another process to finish creating the segment. Past this, the creator is assumed to
+        // have died while initializing the header.
+        constexpr auto InitializeTimeout = std::chrono::milliseconds(100);
+
+        constexpr uint32_t Uninitialized = 0;
+        constexpr uint32_t Initializing = 1;
+        constexpr uint32_t Ready = 2;
+
+        void PutTangents(uint64_t* words, const varjo_FovTangents& tangents) {
+            std::memcpy(words, &tangents, sizeof(tangents));
+        }
+
+        varjo_FovTangents GetTangents(const uint64_t* words) {
+            varjo_FovTangents tangents;
+            std::memcpy(&tangents, words, sizeof(tangents));
+            return tangents;
+        }
+
+        void PutDoubles(uint64_t* words, std::initializer_list<double> values) {
+            for (const double value : values) {
+                std::memcpy(words++, &value, sizeof(value));
+            }
+        }
+
+        double GetDouble(const uint64_t* word) {
+            double value;
+            std::memcpy(&value, word, sizeof(value));
+            return value;
+        }
+
+        bool IsValidTangents(const varjo_FovTangents& tangents) {
+            return std::isfinite(tangents.left) && std::isfinite(tangents.right) && std::isfinite(tangents.top) &&
+                   std::isfinite(tangents.bottom) && tangents.left < tangents.right && tangents.bottom < tangents.top;
+        }
+
+        bool IsValidFraction(double fraction) {
+            return fraction >= 0.0 && fraction <= 1.0;
+        }
+
+        // The records are written by any process of the session: only use the ones that make sense.
+        bool IsValidRecord(const ViewGeometry& geometry) {
+            const auto& fractions = geometry.carveFractions;
+            return IsValidTangents(geometry.fullFovTangents) && IsValidTangents(geometry.focusFovTangents) &&
+                   std::isfinite(geometry.multipliers.horizontal) && geometry.multipliers.horizontal > 0.0 &&
+                   std::isfinite(geometry.multipliers.vertical) && geometry.multipliers.vertical > 0.0 &&
+                   IsValidFraction(fractions.x) && IsValidFraction(fractions.y) && fractions.width > 0.0 &&
+                   fractions.height > 0.0 && IsValidFraction(fractions.x + fractions.width) &&
+                   IsValidFraction(fractions.y + fractions.height) &&
+                   std::all_of(geometry.gridNodes.cbegin(), geometry.gridNodes.cend(), IsValidTangents);
+        }
+
+    } // namespace
+
+    struct GeometrySegment::Header {
+        std::atomic<uint32_t> state;
+
+        // Atomic, since a process may write them concurrently with the creator (with the same values).
+        std::atomic<uint32_t> version;
+        std::atomic<uint32_t> slotCount;
+        std::atomic<uint32_t> slotWords;
+
+        // Logical clock of the uses of the records, shared by the processes.
+        std::atomic<uint64_t> useClock;
+    };
+
+    struct GeometrySegment::Slot {
+        // Odd while the record is being written. The first writer of a slot claims it by moving the sequence from 0.
+        std::atomic<uint64_t> sequence;
+
+        // Zero while the slot is free. Only changes while the sequence is odd (when the record is replaced), so a slot
+        // is never freed once used.
+        std::atomic<uint64_t> key;
+
+        // The useClock value of the last lookup or publication of the record.
+        std::atomic<uint64_t> lastUse;
+
+        // The record, as relaxed atomic words so that concurrent accesses are well-defined.
+        std::atomic<uint64_t> words[SlotWords];
+    };
+
+    GeometrySegment::~GeometrySegment() {
+        Close();
+    }
+
+    void GeometrySegment::Close() {
+        if (!m_header) {
+            return;
+        }
+#ifdef _WIN32
+        UnmapViewOfFile(m_header);
+        CloseHandle(m_handle);
+#else
+        munmap(m_header, m_size);
+#endif
+        m_header = nullptr;
+        m_handle = nullptr;
+    }
+
+    bool GeometrySegment::Open(const std::string& name) {
+        static_assert(sizeof(Header) <= SlotsOffset);
+        const size_t size = SlotsOffset + SlotCount * sizeof(Slot);
+
+        void* view = nullptr;
+#ifdef _WIN32
+        HANDLE mapping = CreateFileMappingA(
+            INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, 0, static_cast<DWORD>(size), name.c_str());
+        if (!mapping) {
+            return false;
+        }
+        view = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, size);
+        if (!view) {
+            CloseHandle(mapping);
+            return false;
+        }
+        m_handle = mapping;
+#else
+        const int fd = shm_open(name.c_str(), O_RDWR | O_CREAT, 0600);
+        if (fd < 0) {
+            return false;
+        }
+        // The segment is zero-filled when it is first sized.
+        struct stat status;
+        if (fstat(fd, &status) != 0 || (status.st_size != 0 && static_cast<size_t>(status.st_size) != size) ||
+            (status.st_size == 0 && ftruncate(fd, size) != 0)) {
+            close(fd);
+            return false;
+        }
+        view = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (view == MAP_FAILED) {
+            return false;
+        }
+#endif
+        m_header = static_cast<Header*>(view);
+        m_size = size;
+
+        // The header fields are the same whichever process writes them, and the slots are left zero-filled.
+        const auto initialize = [this] {
+            m_header->version.store(LayoutVersion, std::memory_order_relaxed);
+            m_header->slotCount.store(SlotCount, std::memory_order_relaxed);
+            m_header->slotWords.store(SlotWords, std::memory_order_relaxed);
+            m_header->state.store(Ready, std::memory_order_release);
+        };
+
+        uint32_t state = Uninitialized;
+        if (m_header->state.compare_exchange_strong(state, Initializing, std::memory_order_acquire)) {
+            initialize();
+        } else {
+            const auto deadline = std::chrono::steady_clock::now() + InitializeTimeout;
+            while (m_header->state.load(std::memory_order_acquire) != Ready &&
+                   std::chrono::steady_clock::now() < deadline) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+
+            // The creator crashed before the segment was ready: finish the initialization in its place, rather than
+            // leaving the segment unusable for the rest of the session.
+            if (m_header->state.load(std::memory_order_acquire) == Initializing) {
+                initialize();
+            }
+        }
+
+        if (m_header->state.load(std::memory_order_acquire) != Ready ||
+            m_header->version.load(std::memory_order_relaxed) != LayoutVersion ||
+            m_header->slotCount.load(std::memory_order_relaxed) != SlotCount ||
+            m_header->slotWords.load(std::memory_order_relaxed) != SlotWords) {
+            Close();
+            return false;
+        }
+        return true;
+    }
+
+    GeometrySegment::Slot* GeometrySegment::GetSlot(size_t index) const {
+        return reinterpret_cast<Slot*>(reinterpret_cast<uint8_t*>(m_header) + SlotsOffset) + index % SlotCount;
+    }
+
+    void GeometrySegment::Touch(Slot& slot) const {
+        slot.lastUse.store(m_header->useClock.fetch_add(1, std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    bool GeometrySegment::Read(const Slot& slot, uint64_t& key, ViewGeometry& geometry) const {
+        std::vector<uint64_t> words(SlotWords);
+        for (int attempt = 0; attempt < ReadAttempts; attempt++) {
+            const uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+            if (sequence == 0 || sequence % 2) {
+                std::this_thread::yield();
+                continue;
+            }
+
+            // The key is read under the sequence, since the record may be replaced.
+            const uint64_t slotKey = slot.key.load(std::memory_order_relaxed);
+            for (size_t i = 0; i < FixedWords; i++) {
+                words[i] = slot.words[i].load(std::memory_order_relaxed);
+            }
+            // May be torn: only trusted once the sequence is validated.
+            const size_t nodeCount = std::min(static_cast<size_t>(words[FixedWords - 1]), MaxGridNodes);
+            for (size_t i = FixedWords; i < FixedWords + 4 * nodeCount; i++) {
+                words[i] = slot.words[i].load(std::memory_order_relaxed);
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot.sequence.load(std::memory_order_relaxed) != sequence) {
+                // Written while reading.
+                continue;
+            }
+
+            key = slotKey;
+            const uint64_t* word = words.data();
+            geometry.fullFovTangents = GetTangents(word);
+            geometry.focusFovTangents = GetTangents(word + 4);
+            geometry.multipliers = {GetDouble(word + 8), GetDouble(word + 9)};
+            geometry.carveFractions = {
+                GetDouble(word + 10), GetDouble(word + 11), GetDouble(word + 12), GetDouble(word + 13)};
+            geometry.gridNodes.resize(nodeCount);
+            for (size_t i = 0; i < nodeCount; i++) {
+                geometry.gridNodes[i] = GetTangents(word + FixedWords + 4 * i);
+            }
+            return true;
+        }
+        return false;
+    }
+
+    bool GeometrySegment::Lookup(uint64_t key, ViewGeometry& geometry) const {
+        if (!m_header || !key) {
+            return false;
+        }
+
+        // Open addressing: the slots are never freed (only replaced), so the first free slot ends the probe.
+        for (size_t i = 0; i < SlotCount; i++) {
+            Slot& slot = *GetSlot(key + i);
+            const uint64_t slotKey = slot.key.load(std::memory_order_acquire);
+            if (slotKey == key) {
+                uint64_t readKey;
+                if (!Read(slot, readKey, geometry) || readKey != key || !IsValidRecord(geometry)) {
+                    return false;
+                }
+                Touch(slot);
+                return true;
+            }
+            if (!slotKey && slot.sequence.load(std::memory_order_acquire) == 0) {
+                break;
+            }
+        }
+        return false;
+    }
+
+    bool GeometrySegment::Publish(uint64_t key, const ViewGeometry& geometry) {
+        if (!m_header || !key || geometry.gridNodes.size() > MaxGridNodes) {
+            return false;
+        }
+
+        std::vector<uint64_t> words(FixedWords + 4 * geometry.gridNodes.size());
+        PutTangents(words.data(), geometry.fullFovTangents);
+        PutTangents(words.data() + 4, geometry.focusFovTangents);
+        PutDoubles(words.data() + 8,
+                   {geometry.multipliers.horizontal,
+                    geometry.multipliers.vertical,
+                    geometry.carveFractions.x,
+                    geometry.carveFractions.y,
+                    geometry.carveFractions.width,
+                    geometry.carveFractions.height});
+        words[FixedWords - 1] = geometry.gridNodes.size();
+        for (size_t i = 0; i < geometry.gridNodes.size(); i++) {
+            PutTangents(words.data() + FixedWords + 4 * i, geometry.gridNodes[i]);
+        }
+
+        // The slot of the record, or a free slot. Otherwise, the least recently used record is replaced.
+        Slot* target = nullptr;
+        uint64_t sequence = 0;
+        Slot* leastRecentlyUsed = nullptr;
+        uint64_t leastRecentlyUsedSequence = 0;
+        for (size_t i = 0; i < SlotCount && !target; i++) {
+            Slot& slot = *GetSlot(key + i);
+            const uint64_t slotSequence = slot.sequence.load(std::memory_order_acquire);
+            const uint64_t slotKey = slot.key.load(std::memory_order_acquire);
+            if (slotKey == key || (!slotKey && !slotSequence)) {
+                target = &slot;
+                sequence = slotSequence;
+            } else if (slotKey && slotSequence % 2 == 0 &&
+                       (!leastRecentlyUsed || slot.lastUse.load(std::memory_order_relaxed) <
+                                                  leastRecentlyUsed->lastUse.load(std::memory_order_relaxed))) {
+                leastRecentlyUsed = &slot;
+                leastRecentlyUsedSequence = slotSequence;
+            }
+        }
+        if (!target) {
+            target = leastRecentlyUsed;
+            sequence = leastRecentlyUsedSequence;
+        }
+        if (!target) {
+            return false;
+        }
+
+        // The claim fails if the slot changed since it was chosen.
+        Slot& slot = *target;
+        if (sequence % 2 ||
+            !slot.sequence.compare_exchange_strong(sequence, sequence + 1, std::memory_order_relaxed)) {
+            // Being written by another process, most likely with the same record.
+            return false;
+        }
+        std::atomic_thread_fence(std::memory_order_release);
+        if (slot.key.load(std::memory_order_relaxed) != key) {
+            slot.key.store(key, std::memory_order_relaxed);
+        }
+        for (size_t j = 0; j < words.size(); j++) {
+            slot.words[j].store(words[j], std::memory_order_relaxed);
+        }
+        Touch(slot);
+        slot.sequence.store(sequence + 2, std::memory_order_release);
+        return true;
+    }
+
+    void
+    GeometrySegment::ForEach(const std::function<void(uint64_t key, const ViewGeometry& geometry)>& visitor) const {
+        if (!m_header) {
+            return;
+        }
+
+        ViewGeometry geometry;
+        for (size_t i = 0; i < SlotCount; i++) {
+            const Slot& slot = *GetSlot(i);
+            uint64_t key;
+            if (slot.key.load(std::memory_order_acquire) && Read(slot, key, geometry)) {
+                visitor(key, geometry);
+            }
+        }
+    }
+
+    void GeometrySegment::Unlink(const std::string& name) {
+#ifndef _WIN32
+        shm_unlink(name.c_str());
+#endif
+    }
+
+} // namespace quadinator::shared
@@ -0,0 +1,122 @@
+// MIT License
+//
+// Copyright(c) 2023 Matthieu Bucchianeri
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this softwareand associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright noticeand this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+// Geometry records shared between the processes that load the DLL, used by the DLL hooks and the offline tools.
+// This header must remain portable (no Windows or Detours dependencies).
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <Varjo_types.h>
+
+#include "geometry.h"
+
+namespace quadinator::shared {
+
+    // The geometry of one focus view and of the stereo view it is carved out of, resolved from the runtime. The
+    // application (through VarjoLib.dll) and vrserver.exe (through VarjoRuntime.dll) query the same headset with the
+    // same settings, so the first process to resolve a view publishes it, and the others reuse it instead of querying
+    // the runtime again.
+    struct ViewGeometry {
+        varjo_FovTangents fullFovTangents{};
+        varjo_FovTangents focusFovTangents{};
+        TextureMultipliers multipliers{};
+
+        // The focus view carved out of the full view, for the focus tangents above (before the FOV crop).
+        CarveFractions carveFractions{};
+
+        // The nodes of the focus grid, when the focus follows the gaze.
+        std::vector<varjo_FovTangents> gridNodes;
+    };
+
+    // Largest focus grid that can be published.
+    constexpr size_t MaxGridNodes = 4096;
+
+    // Bump when the layout of the segment or the meaning of the records change.
+    constexpr uint32_t LayoutVersion = 4;
+
+    inline std::string GetSegmentName() {
+#ifdef _WIN32
+        return "Local\\Quadinator-Geometry-" + std::to_string(LayoutVersion);
+#else
+        return "/quadinator-geometry-" + std::to_string(LayoutVersion);
+#endif
+    }
+
+    // A named shared memory segment holding the geometry records, keyed by the settings they were resolved with. The
+    // segment is created by the first process to open it. Records are written under a per-record sequence number
+    // (seqlock): readers never block, and retry or give up when racing with a writer. A record being written by
+    // another process is skipped rather than waited for. When the segment is full, the least recently used record is
+    // replaced. If the creator dies while initializing the segment, the next process to open it finishes the
+    // initialization once it gave up waiting.
+    class GeometrySegment {
+      public:
+        GeometrySegment() = default;
+        GeometrySegment(const GeometrySegment&) = delete;
+        GeometrySegment& operator=(const GeometrySegment&) = delete;
+        ~GeometrySegment();
+
+        // Create or open the segment. Returns false if the segment cannot be mapped, or was created with another
+        // layout.
+        bool Open(const std::string& name = GetSegmentName());
+
+        bool IsOpen() const {
+            return m_header != nullptr;
+        }
+
+        // Copy the record for the key. Returns false if there is none, if it is being written, or if it is not valid
+        // (eg: non-finite tangents, carve outside of the full view).
+        bool Lookup(uint64_t key, ViewGeometry& geometry) const;
+
+        // Publish (or replace) the record for the key. Returns false if the segment is full, or if the record is being
+        // written by another process.
+        bool Publish(uint64_t key, const ViewGeometry& geometry);
+
+        // Visit the records that can be read.
+        void ForEach(const std::function<void(uint64_t key, const ViewGeometry& geometry)>& visitor) const;
+
+        // Remove the segment name, so that the next process to open it creates a new segment. The processes that
+        // already mapped the segment keep using it.
+        static void Unlink(const std::string& name = GetSegmentName());
+
+      private:
+        struct Header;
+        struct Slot;
+
+        void Close();
+        bool Read(const Slot& slot, uint64_t& key, ViewGeometry& geometry) const;
+        void Touch(Slot& slot) const;
+        Slot* GetSlot(size_t index) const;
+
+        Header* m_header{nullptr};
+        size_t m_size{0};
+        void* m_handle{nullptr};
+    };
+
+} // namespace quadinator::shared
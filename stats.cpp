@@ -0,0 +1,106 @@
+// MIT License
+//
+// Copyright(c) 2023 Matthieu Bucchianeri
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this softwareand associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright noticeand this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <cstdio>
+#include <iterator>
+
+#include "stats.h"
+
+namespace quadinator::stats {
+
+    HookStats g_hookStats[static_cast<uint32_t>(Hook::Count)];
+    FrameStats g_frameStats;
+    CacheStats g_cacheStats;
+
+    namespace {
+        constexpr const char* HookNames[] = {
+            "varjo_GetTextureSize",
+            "varjo_GetViewDescription",
+            "varjo_EndFrameWithLayers",
+        };
+        static_assert(std::size(HookNames) == static_cast<size_t>(Hook::Count));
+    } // namespace
+
+    std::string Format() {
+        std::string result;
+        char buf[256];
+        for (uint32_t i = 0; i < static_cast<uint32_t>(Hook::Count); i++) {
+            const auto& stats = g_hookStats[i];
+            const uint64_t calls = stats.calls.load(std::memory_order_relaxed);
+            const uint64_t totalNs = stats.totalNs.load(std::memory_order_relaxed);
+            snprintf(buf,
+                     sizeof(buf),
+                     "%s: calls=%llu avg_us=%.2f max_us=%.2f\n",
+                     HookNames[i],
+                     static_cast<unsigned long long>(calls),
+                     calls ? totalNs / 1000.0 / calls : 0.0,
+                     stats.maxNs.load(std::memory_order_relaxed) / 1000.0);
+            result += buf;
+        }
+        result += "frame: " + FormatFrame(g_frameStats);
+        snprintf(buf,
+                 sizeof(buf),
+                 "cache: grid_lookups=%llu grid_check_failures=%llu grid_disables=%llu shared_hits=%llu "
+                 "shared_misses=%llu shared_carves=%llu\n",
+                 static_cast<unsigned long long>(g_cacheStats.gridLookups.load(std::memory_order_relaxed)),
+                 static_cast<unsigned long long>(g_cacheStats.gridCheckFailures.load(std::memory_order_relaxed)),
+                 static_cast<unsigned long long>(g_cacheStats.gridDisables.load(std::memory_order_relaxed)),
+                 static_cast<unsigned long long>(g_cacheStats.sharedHits.load(std::memory_order_relaxed)),
+                 static_cast<unsigned long long>(g_cacheStats.sharedMisses.load(std::memory_order_relaxed)),
+                 static_cast<unsigned long long>(g_cacheStats.sharedCarves.load(std::memory_order_relaxed)));
+        result += buf;
+        return result;
+    }
+
+    std::string FormatFrame(const FrameStats& frameStats) {
+        char buf[256];
+        snprintf(buf,
+                 sizeof(buf),
+                 "stereo_pixels=%llu focus_pixels=%llu carved_views=%llu held_views=%llu synthesized_views=%llu "
+                 "carved_depths=%llu carved_velocities=%llu\n",
+                 static_cast<unsigned long long>(frameStats.stereoPixels.load(std::memory_order_relaxed)),
+                 static_cast<unsigned long long>(frameStats.focusPixels.load(std::memory_order_relaxed)),
+                 static_cast<unsigned long long>(frameStats.carvedViews.load(std::memory_order_relaxed)),
+                 static_cast<unsigned long long>(frameStats.heldViews.load(std::memory_order_relaxed)),
+                 static_cast<unsigned long long>(frameStats.synthesizedViews.load(std::memory_order_relaxed)),
+                 static_cast<unsigned long long>(frameStats.carvedDepths.load(std::memory_order_relaxed)),
+                 static_cast<unsigned long long>(frameStats.carvedVelocities.load(std::memory_order_relaxed)));
+        return buf;
+    }
+
+    void Reset() {
+        for (auto& stats : g_hookStats) {
+            stats.calls = 0;
+            stats.totalNs = 0;
+            stats.maxNs = 0;
+        }
+        for (auto* counter : {&g_cacheStats.gridLookups,
+                              &g_cacheStats.gridCheckFailures,
+                              &g_cacheStats.gridDisables,
+                              &g_cacheStats.sharedHits,
+                              &g_cacheStats.sharedMisses,
+                              &g_cacheStats.sharedCarves}) {
+            counter->store(0, std::memory_order_relaxed);
+        }
+    }
+
+} // namespace quadinator::stats
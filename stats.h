@@ -0,0 +1,111 @@
+// MIT License
+//
+// Copyright(c) 2023 Matthieu Bucchianeri
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this softwareand associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright noticeand this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+namespace quadinator::stats {
+
+    // Live statistics. Counters are updated with relaxed atomics from the hooks and read by the control channel.
+
+    enum class Hook : uint32_t {
+        GetTextureSize,
+        GetViewDescription,
+        EndFrameWithLayers,
+
+        Count
+    };
+
+    struct HookStats {
+        std::atomic<uint64_t> calls{0};
+        std::atomic<uint64_t> totalNs{0};
+        std::atomic<uint64_t> maxNs{0};
+    };
+
+    struct FrameStats {
+        // Pixels of the reference (stereo) views and carved focus views in the last frame (of any session in
+        // g_frameStats).
+        std::atomic<uint64_t> stereoPixels{0};
+        std::atomic<uint64_t> focusPixels{0};
+        std::atomic<uint64_t> carvedViews{0};
+        // Carved focus views that reused the geometry of the previous frame.
+        std::atomic<uint64_t> heldViews{0};
+        // Carved focus views added to the stereo layers.
+        std::atomic<uint64_t> synthesizedViews{0};
+        // Carved focus views that also received a carved depth or velocity.
+        std::atomic<uint64_t> carvedDepths{0};
+        std::atomic<uint64_t> carvedVelocities{0};
+    };
+
+    struct CacheStats {
+        // Focus tangents served from the focus grids, and the spot-checks against the runtime that failed.
+        std::atomic<uint64_t> gridLookups{0};
+        std::atomic<uint64_t> gridCheckFailures{0};
+        // Sessions that stopped using their focus grids after a failed spot-check.
+        std::atomic<uint64_t> gridDisables{0};
+        // Geometry resolutions served from (or missing in) the records shared between the processes.
+        std::atomic<uint64_t> sharedHits{0};
+        std::atomic<uint64_t> sharedMisses{0};
+        // Carved focus views that used the carve of the shared records.
+        std::atomic<uint64_t> sharedCarves{0};
+    };
+
+    extern HookStats g_hookStats[static_cast<uint32_t>(Hook::Count)];
+    extern FrameStats g_frameStats;
+    extern CacheStats g_cacheStats;
+
+    // Measure the latency of a hook for the current scope.
+    class ScopedLatency {
+      public:
+        explicit ScopedLatency(Hook hook) : m_hook(hook), m_start(std::chrono::steady_clock::now()) {
+        }
+
+        ~ScopedLatency() {
+            const uint64_t elapsedNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                           std::chrono::steady_clock::now() - m_start)
+                                           .count();
+            auto& stats = g_hookStats[static_cast<uint32_t>(m_hook)];
+            stats.calls.fetch_add(1, std::memory_order_relaxed);
+            stats.totalNs.fetch_add(elapsedNs, std::memory_order_relaxed);
+            uint64_t maxNs = stats.maxNs.load(std::memory_order_relaxed);
+            while (elapsedNs > maxNs && !stats.maxNs.compare_exchange_weak(maxNs, elapsedNs, std::memory_order_relaxed))
+                ;
+        }
+
+      private:
+        const Hook m_hook;
+        const std::chrono::steady_clock::time_point m_start;
+    };
+
+    // Human-readable dump of all the statistics.
+    std::string Format();
+
+    // Human-readable dump of the statistics of one frame.
+    std::string FormatFrame(const FrameStats& frameStats);
+
+    void Reset();
+
+} // namespace quadinator::stats
@@ -0,0 +1,249 @@
+// MIT License
+//
+// Copyright(c) 2023 Matthieu Bucchianeri
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this softwareand associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright noticeand this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Offline gaze tools: evaluates the gaze processing against recorded gaze traces.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "gaze.h"
+#include "gazetrace.h"
+
+/////////////////////////////////////////////////////////////////////////////
+// Usage:
+//   QuadGaze replay <trace> [--horizon-ms H] [--dead-zone D]
+//   QuadGaze generate <trace> [--duration S] [--rate HZ] [--seed N]
+//
+// Traces are either binary (recorded with gaze_trace, or generated), or CSV (one sample per line, '#' for comments):
+//   capture_time_ns,forward_x,forward_y,forward_z[,status]
+
+namespace {
+
+    using namespace quadinator::gaze;
+
+    struct Sample {
+        int64_t timeNs;
+        GazeAngles angles;
+        bool valid;
+    };
+
+    bool LoadSamples(const char* path, std::vector<varjo_Gaze>& trace, std::vector<Sample>& samples) {
+        if (!LoadTrace(path, trace)) {
+            return false;
+        }
+        for (const auto& gaze : trace) {
+            samples.push_back({gaze.captureTime, ToAngles(gaze.gaze), gaze.status == 2 /* Valid */});
+        }
+        return true;
+    }
+
+    // Ground truth at an arbitrary time, interpolated between the two nearest valid samples.
+    bool Interpolate(const std::vector<Sample>& samples, size_t hint, int64_t timeNs, GazeAngles& angles) {
+        for (size_t i = hint; i + 1 < samples.size(); i++) {
+            const auto& a = samples[i];
+            const auto& b = samples[i + 1];
+            if (b.timeNs < timeNs) {
+                continue;
+            }
+            if (a.timeNs > timeNs || !a.valid || !b.valid || b.timeNs == a.timeNs) {
+                return false;
+            }
+            const double t = static_cast<double>(timeNs - a.timeNs) / (b.timeNs - a.timeNs);
+            angles = {a.angles.yaw + t * (b.angles.yaw - a.angles.yaw),
+                      a.angles.pitch + t * (b.angles.pitch - a.angles.pitch)};
+            return true;
+        }
+        return false;
+    }
+
+    void PrintErrors(const char* name, std::vector<double>& errors) {
+        if (errors.empty()) {
+            printf("%-8s no samples\n", name);
+            return;
+        }
+        std::sort(errors.begin(), errors.end());
+        double sum = 0;
+        for (const double error : errors) {
+            sum += error;
+        }
+        printf("%-8s samples=%zu mean=%.3f p50=%.3f p95=%.3f p99=%.3f max=%.3f (degrees)\n",
+               name,
+               errors.size(),
+               sum / errors.size(),
+               errors[errors.size() / 2],
+               errors[errors.size() * 95 / 100],
+               errors[errors.size() * 99 / 100],
+               errors.back());
+    }
+
+    // Feed the trace to each predictor and compare the prediction with the recorded gaze at the horizon.
+    void Replay(const std::vector<Sample>& samples, int64_t horizonNs) {
+        const struct {
+            const char* name;
+            PredictorType type;
+        } predictors[] = {
+            {"none", PredictorType::None},
+            {"linear", PredictorType::ConstantVelocity},
+            {"kalman", PredictorType::Kalman},
+        };
+
+        printf("Horizon: %.1f ms\n", horizonNs / 1e6);
+        for (const auto& entry : predictors) {
+            GazePredictor predictor(entry.type);
+            std::vector<double> errors;
+            for (size_t i = 0; i < samples.size(); i++) {
+                if (!samples[i].valid) {
+                    continue;
+                }
+                predictor.Update(samples[i].timeNs, samples[i].angles);
+
+                GazeAngles actual;
+                if (Interpolate(samples, i, samples[i].timeNs + horizonNs, actual)) {
+                    errors.push_back(AngularDistance(predictor.Predict(samples[i].timeNs + horizonNs), actual));
+                }
+            }
+            PrintErrors(entry.name, errors);
+        }
+    }
+
+    // Feed the trace to the stabilizer and report how often the focus moves, and how far it lags behind the gaze.
+    void Stabilize(const std::vector<Sample>& samples, double deadZone) {
+        GazeStabilizer stabilizer;
+        uint64_t updates = 0;
+        uint64_t moves = 0;
+        uint64_t saccades = 0;
+        std::vector<double> errors;
+        for (const auto& sample : samples) {
+            if (!sample.valid) {
+                continue;
+            }
+            const EyeMovement previous = stabilizer.movement();
+            const auto focus = stabilizer.Update(sample.timeNs, sample.angles, deadZone);
+            updates++;
+            moves += stabilizer.moved();
+            saccades += previous != EyeMovement::Saccade && stabilizer.movement() == EyeMovement::Saccade;
+            errors.push_back(AngularDistance(focus, sample.angles));
+        }
+
+        printf("Dead-zone: %.2f degrees, focus moved on %llu of %llu samples (%.1f%%), %llu saccades\n",
+               deadZone,
+               static_cast<unsigned long long>(moves),
+               static_cast<unsigned long long>(updates),
+               updates ? 100.0 * moves / updates : 0.0,
+               static_cast<unsigned long long>(saccades));
+        PrintErrors("held", errors);
+    }
+
+    // Feed the trace to the tracking fallback and report the time spent in each state.
+    void Fallback(const std::vector<varjo_Gaze>& trace, double blendTime) {
+        GazeFallback fallback;
+        uint64_t counts[3]{};
+        uint64_t losses = 0;
+        for (const auto& gaze : trace) {
+            const auto previous = fallback.state();
+            fallback.Update(gaze.captureTime, gaze, blendTime);
+            counts[static_cast<int>(fallback.state())]++;
+            losses += previous == TrackingState::Tracking && fallback.state() == TrackingState::Lost;
+        }
+        printf("Tracking: lost=%llu acquiring=%llu tracking=%llu samples, %llu losses\n",
+               static_cast<unsigned long long>(counts[0]),
+               static_cast<unsigned long long>(counts[1]),
+               static_cast<unsigned long long>(counts[2]),
+               static_cast<unsigned long long>(losses));
+    }
+
+    int Usage() {
+        fprintf(stderr,
+                "Usage:\n"
+                "  QuadGaze replay <trace> [--horizon-ms H] [--dead-zone D]\n"
+                "  QuadGaze generate <trace> [--duration S] [--rate HZ] [--seed N]\n");
+        return 1;
+    }
+
+    int Generate(const char* path, double duration, double rate, uint32_t seed) {
+        SynthesisSettings settings;
+        settings.rate = rate;
+        GazeSynthesizer synthesizer(seed, settings);
+        TraceWriter writer;
+        if (!writer.Open(path)) {
+            fprintf(stderr, "Cannot write trace %s\n", path);
+            return 1;
+        }
+        const auto count = static_cast<uint64_t>(duration * rate);
+        for (uint64_t i = 0; i < count; i++) {
+            writer.Write(synthesizer.Next());
+        }
+        writer.Close();
+        printf("Generated %llu samples\n", static_cast<unsigned long long>(count));
+        return 0;
+    }
+
+} // namespace
+
+int main(int argc, char** argv) {
+    if (argc < 3 || (std::string_view(argv[1]) != "replay" && std::string_view(argv[1]) != "generate")) {
+        return Usage();
+    }
+    const bool isReplay = std::string_view(argv[1]) == "replay";
+
+    double horizonMs = 20.0;
+    double deadZone = 1.0;
+    double duration = 60.0;
+    double rate = 200.0;
+    uint32_t seed = 1;
+    for (int i = 3; i + 1 < argc; i += 2) {
+        const std::string_view option(argv[i]);
+        if (isReplay && option == "--horizon-ms") {
+            horizonMs = strtod(argv[i + 1], nullptr);
+        } else if (isReplay && option == "--dead-zone") {
+            deadZone = strtod(argv[i + 1], nullptr);
+        } else if (!isReplay && option == "--duration") {
+            duration = strtod(argv[i + 1], nullptr);
+        } else if (!isReplay && option == "--rate") {
+            rate = strtod(argv[i + 1], nullptr);
+        } else if (!isReplay && option == "--seed") {
+            seed = static_cast<uint32_t>(strtoul(argv[i + 1], nullptr, 10));
+        } else {
+            return Usage();
+        }
+    }
+
+    if (!isReplay) {
+        return Generate(argv[2], duration, rate, seed);
+    }
+
+    std::vector<varjo_Gaze> trace;
+    std::vector<Sample> samples;
+    if (!LoadSamples(argv[2], trace, samples)) {
+        fprintf(stderr, "Cannot read trace %s\n", argv[2]);
+        return 1;
+    }
+    Replay(samples, static_cast<int64_t>(horizonMs * 1e6));
+    Stabilize(samples, deadZone);
+    Fallback(trace, 0.2);
+
+    return 0;
+}
@@ -0,0 +1,143 @@
+// MIT License
+//
+// Copyright(c) 2023 Matthieu Bucchianeri
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this softwareand associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright noticeand this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+// Offline export resolution: checks and times the resolution of the exports of a PE image (eg: VarjoRuntime.dll),
+// with the binary search that GetProcAddress() does when Quadinator installs its hooks.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "pe.h"
+
+/////////////////////////////////////////////////////////////////////////////
+// Usage:
+//   QuadExports <image> [--bench N] [name...]
+//
+// Without names, every export of the image is resolved. The export names must be sorted for the binary search.
+
+namespace {
+
+    using namespace quadinator::pe;
+
+    const char* StatusName(ExportStatus status) {
+        switch (status) {
+        case ExportStatus::Resolved:
+            return "resolved";
+        case ExportStatus::Forwarded:
+            return "forwarded";
+        default:
+            return "missing";
+        }
+    }
+
+    int Usage() {
+        fprintf(stderr, "Usage:\n  QuadExports <image> [--bench N] [name...]\n");
+        return 1;
+    }
+
+    template <typename Func>
+    double TimeUs(int iterations, Func func) {
+        const auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; i++) {
+            func();
+        }
+        return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() /
+               iterations;
+    }
+
+} // namespace
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        return Usage();
+    }
+
+    int iterations = 0;
+    std::vector<std::string> requested;
+    for (int i = 2; i < argc; i++) {
+        if (std::string_view(argv[i]) == "--bench") {
+            if (i + 1 >= argc) {
+                return Usage();
+            }
+            iterations = atoi(argv[++i]);
+        } else {
+            requested.push_back(argv[i]);
+        }
+    }
+
+    std::ifstream file(argv[1], std::ios::binary);
+    if (!file) {
+        fprintf(stderr, "Cannot read image %s\n", argv[1]);
+        return 1;
+    }
+    const std::vector<char> image{std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+    ExportTable exports;
+    if (!exports.Parse(image.data(), image.size(), ImageLayout::File)) {
+        fprintf(stderr, "Not a valid PE image: %s\n", argv[1]);
+        return 1;
+    }
+    printf("Image: %zu bytes, %u named exports\n", image.size(), exports.count());
+
+    std::vector<std::string_view> names(requested.begin(), requested.end());
+    if (names.empty()) {
+        for (uint32_t i = 0; i < exports.count(); i++) {
+            names.push_back(exports.name(i));
+        }
+    }
+
+    uint32_t unsorted = 0;
+    for (uint32_t i = 1; i < exports.count(); i++) {
+        unsorted += !(exports.name(i - 1) < exports.name(i));
+    }
+
+    uint32_t resolved = 0;
+    for (const auto& name : names) {
+        const auto result = exports.Find(name);
+        resolved += result.status != ExportStatus::Missing;
+        if (!requested.empty() || result.status == ExportStatus::Missing) {
+            printf("  %-10s 0x%08x %.*s\n",
+                   StatusName(result.status),
+                   result.rva,
+                   static_cast<int>(name.size()),
+                   name.data());
+        }
+    }
+    printf("Resolved %u of %zu names, %u unsorted export names\n", resolved, names.size(), unsorted);
+
+    if (iterations > 0) {
+        const double find = TimeUs(iterations, [&] {
+            for (const auto& name : names) {
+                (void)exports.Find(name);
+            }
+        });
+        printf("Find: %.3f us (%zu names)\n", find, names.size());
+    }
+
+    return unsorted || resolved < names.size() ? 1 : 0;
+}
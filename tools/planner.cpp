@@ -0,0 +1,435 @@
+// MIT License
+//
+// Copyright(c) 2023 Matthieu Bucchianeri
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this softwareand associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright noticeand this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Offline resolution planner: evaluates the texture sizes and focus carving that Quadinator would apply for a given
+// headset and settings, without a headset.
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "geometry.h"
+
+/////////////////////////////////////////////////////////////////////////////
+// Usage:
+//   QuadPlanner plan  <headset> [--ppd-scale S] [--fov-crop C] [--alignment A]
+//   QuadPlanner sweep <headset> [--ppd-scale LIST] [--fov-crop LIST] [--alignment LIST] [--threads N]
+//
+// Headset, as reported to the DLL (see the varjo_GetTextureSize_* events of a trace captured with Capture-ETL.bat, the
+// angles are in radians):
+//   --full L,R,T,B [--full-right L,R,T,B] Context view tangents (the right eye mirrors the left eye by default).
+//   --focus L,R,T,B [--focus-right ...]   Focus view tangents (same). Repeat for each focus region, in view order.
+//   --focus-size WxH                      Focus view texture size (DynamicFoveation) of the last focus region.
+//   --envelope H,V [--envelope-right H,V] Gaze envelope multipliers of the last focus region, when the focus follows
+//                                         the gaze (the right eye uses the left eye multipliers by default).
+//   --stereo-size WxH                     Native stereo view texture size.
+//   --context-size WxH                    Native quad context view texture size.
+//
+// Lists are comma-separated values or a range "first:last:step". The sweep reports the first focus region.
+
+namespace {
+
+    using namespace quadinator;
+
+    struct FocusRegion {
+        varjo_FovTangents fov[2];
+        bool hasRight;
+        int32_t size[2];
+
+        // The multipliers over the gaze envelope, when the focus follows the gaze.
+        TextureMultipliers envelope[2];
+        bool hasEnvelope;
+        bool hasEnvelopeRight;
+    };
+
+    // What the runtime reports for a headset, per eye.
+    struct Headset {
+        varjo_FovTangents fullFov[2];
+        std::vector<FocusRegion> focusRegions;
+        int32_t stereoSize[2];
+        int32_t contextSize[2];
+
+        int32_t viewCount() const {
+            return StereoViewCount * (1 + static_cast<int32_t>(focusRegions.size()));
+        }
+
+        const FocusRegion& focusRegion(int32_t focusView) const {
+            return focusRegions[focusView / StereoViewCount - 1];
+        }
+    };
+
+    struct PlanResult {
+        SizingSettings settings;
+
+        // What hooked_GetTextureSize() reports for the stereo views.
+        int32_t stereoWidth[2];
+        int32_t stereoHeight[2];
+
+        // What hooked_EndFrameWithLayers() carves for the focus views (with a forward gaze), in view order.
+        std::vector<varjo_SwapChainViewport> focusViewports;
+
+        uint64_t stereoPixels;
+        uint64_t focusPixels;
+        uint64_t nativeStereoPixels;
+        uint64_t nativeQuadPixels;
+    };
+
+    PlanResult Plan(const Headset& headset, const SizingSettings& settings) {
+        PlanResult result{};
+        result.settings = settings;
+        result.focusViewports.resize(headset.viewCount() - StereoViewCount);
+        for (int32_t eye = 0; eye < StereoViewCount; eye++) {
+            // The same sizing as hooked_GetTextureSize().
+            int32_t width, height;
+            ComputeStereoViewTextureSize(
+                eye,
+                headset.viewCount(),
+                settings,
+                [&](int32_t focusView, int32_t* focusWidth, int32_t* focusHeight) {
+                    const auto& region = headset.focusRegion(focusView);
+                    *focusWidth = region.size[0];
+                    *focusHeight = region.size[1];
+                    return region.hasEnvelope ? region.envelope[eye]
+                                              : ComputeTextureMultipliers(headset.fullFov[eye], region.fov[eye]);
+                },
+                &width,
+                &height);
+            result.stereoWidth[eye] = width;
+            result.stereoHeight[eye] = height;
+
+            // The application renders the full FOV into the whole stereo texture.
+            varjo_SwapChainViewport referenceViewport{};
+            referenceViewport.width = width;
+            referenceViewport.height = height;
+            result.nativeStereoPixels += static_cast<uint64_t>(headset.stereoSize[0]) * headset.stereoSize[1];
+            result.nativeQuadPixels += static_cast<uint64_t>(headset.contextSize[0]) * headset.contextSize[1];
+            result.stereoPixels += static_cast<uint64_t>(width) * height;
+            for (int32_t focusView = StereoViewCount + eye; focusView < headset.viewCount();
+                 focusView += StereoViewCount) {
+                const auto& region = headset.focusRegion(focusView);
+                auto& focusViewport = result.focusViewports[focusView - StereoViewCount];
+                focusViewport = {};
+                CarveViewport(focusViewport,
+                              referenceViewport,
+                              ComputeCarveFractions(AlignedViewFromTangents(headset.fullFov[eye]),
+                                                    CropFovTangents(region.fov[eye], settings.fovCrop)),
+                              settings.alignment);
+
+                result.focusPixels += static_cast<uint64_t>(focusViewport.width) * focusViewport.height;
+                result.nativeQuadPixels += static_cast<uint64_t>(region.size[0]) * region.size[1];
+            }
+        }
+        return result;
+    }
+
+    double Savings(uint64_t pixels, uint64_t reference) {
+        return reference ? 100.0 * (1.0 - static_cast<double>(pixels) / reference) : 0.0;
+    }
+
+    void PrintPlan(const PlanResult& result) {
+        printf("Settings: ppd-scale=%.3f fov-crop=%.3f alignment=%u\n",
+               result.settings.ppdScale,
+               result.settings.fovCrop,
+               result.settings.alignment);
+        for (int32_t eye = 0; eye < StereoViewCount; eye++) {
+            printf("View %d: stereo %dx%d\n", eye, result.stereoWidth[eye], result.stereoHeight[eye]);
+        }
+        for (size_t i = 0; i < result.focusViewports.size(); i++) {
+            const int32_t focusView = StereoViewCount + static_cast<int32_t>(i);
+            const auto& focus = result.focusViewports[i];
+            printf("View %d: focus carved out of view %d at (%d, %d) %dx%d\n",
+                   focusView,
+                   ReferenceViews[focusView],
+                   focus.x,
+                   focus.y,
+                   focus.width,
+                   focus.height);
+        }
+        printf("Rendered pixels:      %12llu\n", static_cast<unsigned long long>(result.stereoPixels));
+        printf("Carved focus pixels:  %12llu\n", static_cast<unsigned long long>(result.focusPixels));
+        printf("Native stereo pixels: %12llu (savings %+.1f%%)\n",
+               static_cast<unsigned long long>(result.nativeStereoPixels),
+               Savings(result.stereoPixels, result.nativeStereoPixels));
+        printf("Native quad pixels:   %12llu (savings %+.1f%%)\n",
+               static_cast<unsigned long long>(result.nativeQuadPixels),
+               Savings(result.stereoPixels, result.nativeQuadPixels));
+    }
+
+    void PrintSweepHeader() {
+        printf("ppd_scale,fov_crop,alignment,width0,height0,width1,height1,focus_width0,focus_height0,focus_width1,"
+               "focus_height1,pixels,focus_pixels,savings_stereo,savings_quad\n");
+    }
+
+    void PrintSweepRow(const PlanResult& result) {
+        printf("%.3f,%.3f,%u,%d,%d,%d,%d,%d,%d,%d,%d,%llu,%llu,%.2f,%.2f\n",
+               result.settings.ppdScale,
+               result.settings.fovCrop,
+               result.settings.alignment,
+               result.stereoWidth[0],
+               result.stereoHeight[0],
+               result.stereoWidth[1],
+               result.stereoHeight[1],
+               result.focusViewports[0].width,
+               result.focusViewports[0].height,
+               result.focusViewports[1].width,
+               result.focusViewports[1].height,
+               static_cast<unsigned long long>(result.stereoPixels),
+               static_cast<unsigned long long>(result.focusPixels),
+               Savings(result.stereoPixels, result.nativeStereoPixels),
+               Savings(result.stereoPixels, result.nativeQuadPixels));
+    }
+
+    // Evaluate the grid on all cores. Results are stored in grid order to keep the output deterministic.
+    std::vector<PlanResult> Sweep(const Headset& headset,
+                                  const std::vector<SizingSettings>& grid,
+                                  uint32_t threadCount) {
+        std::vector<PlanResult> results(grid.size());
+        std::atomic<size_t> next{0};
+        auto worker = [&]() {
+            for (size_t i = next++; i < grid.size(); i = next++) {
+                results[i] = Plan(headset, grid[i]);
+            }
+        };
+
+        std::vector<std::thread> threads;
+        for (uint32_t i = 1; i < threadCount; i++) {
+            threads.emplace_back(worker);
+        }
+        worker();
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        return results;
+    }
+
+    varjo_FovTangents Tangents(double left, double right, double top, double bottom) {
+        varjo_FovTangents tangents{};
+        tangents.left = left;
+        tangents.right = right;
+        tangents.top = top;
+        tangents.bottom = bottom;
+        return tangents;
+    }
+
+    // The right eye mirrors the left eye.
+    varjo_FovTangents Mirror(const varjo_FovTangents& tangents) {
+        return Tangents(-tangents.right, -tangents.left, tangents.top, tangents.bottom);
+    }
+
+    bool IsValidFov(const varjo_FovTangents& tangents) {
+        return tangents.right > tangents.left && tangents.top > tangents.bottom;
+    }
+
+    bool ParseTangents(const char* value, varjo_FovTangents& tangents) {
+        double left, right, top, bottom;
+        if (sscanf(value, "%lf,%lf,%lf,%lf", &left, &right, &top, &bottom) != 4) {
+            return false;
+        }
+        tangents = Tangents(left, right, top, bottom);
+        return true;
+    }
+
+    bool ParseMultipliers(const char* value, TextureMultipliers& multipliers) {
+        return sscanf(value, "%lf,%lf", &multipliers.horizontal, &multipliers.vertical) == 2 &&
+               multipliers.horizontal > 0 && multipliers.vertical > 0;
+    }
+
+    bool ParseSize(const char* value, int32_t size[2]) {
+        return sscanf(value, "%dx%d", &size[0], &size[1]) == 2 && size[0] > 0 && size[1] > 0;
+    }
+
+    bool ParseList(const char* value, std::vector<double>& list) {
+        list.clear();
+        double first, last, step;
+        if (strchr(value, ':')) {
+            if (sscanf(value, "%lf:%lf:%lf", &first, &last, &step) != 3 || step <= 0 || last < first) {
+                return false;
+            }
+            // Tolerate rounding on the last step.
+            for (double v = first; v <= last + step * 1e-6; v += step) {
+                list.push_back(v);
+            }
+        } else {
+            std::string_view remaining(value);
+            while (!remaining.empty()) {
+                const auto comma = remaining.find(',');
+                const std::string item(remaining.substr(0, comma));
+                char* end = nullptr;
+                list.push_back(strtod(item.c_str(), &end));
+                if (item.empty() || *end) {
+                    return false;
+                }
+                remaining = comma == std::string_view::npos ? std::string_view() : remaining.substr(comma + 1);
+            }
+        }
+        return !list.empty();
+    }
+
+    int Usage() {
+        fprintf(stderr,
+                "Usage:\n"
+                "  QuadPlanner plan  <headset> [--ppd-scale S] [--fov-crop C] [--alignment A]\n"
+                "  QuadPlanner sweep <headset> [--ppd-scale LIST] [--fov-crop LIST] [--alignment LIST] [--threads N]\n"
+                "\n"
+                "Headset:\n"
+                "  --full L,R,T,B [--full-right L,R,T,B] --stereo-size WxH --context-size WxH\n"
+                "  --focus L,R,T,B [--focus-right L,R,T,B] --focus-size WxH [--envelope H,V [--envelope-right H,V]]\n"
+                "  (repeat --focus for each focus region)\n"
+                "\n"
+                "Lists are comma-separated values or a range first:last:step.\n");
+        return 1;
+    }
+
+} // namespace
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        return Usage();
+    }
+
+    const std::string_view command(argv[1]);
+    if (command != "plan" && command != "sweep") {
+        return Usage();
+    }
+
+    Headset headset{};
+    bool hasFullRight = false;
+    std::vector<double> ppdScales{1.0}, fovCrops{0.0}, alignments{2};
+    uint32_t threadCount = std::max(1u, std::thread::hardware_concurrency());
+    for (int i = 2; i < argc; i++) {
+        const std::string_view option(argv[i]);
+        if (i + 1 >= argc) {
+            fprintf(stderr, "Missing value for %s\n", argv[i]);
+            return Usage();
+        }
+        const char* value = argv[++i];
+
+        bool ok = true;
+        if (option == "--full") {
+            ok = ParseTangents(value, headset.fullFov[0]);
+        } else if (option == "--full-right") {
+            ok = hasFullRight = ParseTangents(value, headset.fullFov[1]);
+        } else if (option == "--focus") {
+            ok = headset.viewCount() < MaxViewCount;
+            if (ok) {
+                headset.focusRegions.push_back({});
+                ok = ParseTangents(value, headset.focusRegions.back().fov[0]);
+            }
+        } else if (option == "--focus-right") {
+            ok = !headset.focusRegions.empty() && ParseTangents(value, headset.focusRegions.back().fov[1]);
+            if (ok) {
+                headset.focusRegions.back().hasRight = true;
+            }
+        } else if (option == "--focus-size") {
+            ok = !headset.focusRegions.empty() && ParseSize(value, headset.focusRegions.back().size);
+        } else if (option == "--stereo-size") {
+            ok = ParseSize(value, headset.stereoSize);
+        } else if (option == "--context-size") {
+            ok = ParseSize(value, headset.contextSize);
+        } else if (option == "--envelope") {
+            ok = !headset.focusRegions.empty() && ParseMultipliers(value, headset.focusRegions.back().envelope[0]);
+            if (ok) {
+                headset.focusRegions.back().hasEnvelope = true;
+            }
+        } else if (option == "--envelope-right") {
+            ok = !headset.focusRegions.empty() && ParseMultipliers(value, headset.focusRegions.back().envelope[1]);
+            if (ok) {
+                headset.focusRegions.back().hasEnvelopeRight = true;
+            }
+        } else if (option == "--ppd-scale") {
+            ok = ParseList(value, ppdScales) &&
+                 std::all_of(ppdScales.cbegin(), ppdScales.cend(), [](double v) { return std::isfinite(v) && v > 0; });
+        } else if (option == "--fov-crop") {
+            ok = ParseList(value, fovCrops) &&
+                 std::all_of(fovCrops.cbegin(), fovCrops.cend(), [](double v) { return v >= 0 && v < 1; });
+        } else if (option == "--alignment") {
+            ok = ParseList(value, alignments) && std::all_of(alignments.cbegin(), alignments.cend(), [](double v) {
+                     return v >= 1 && v <= MaxAlignment && IsValidAlignment(static_cast<uint32_t>(v));
+                 });
+        } else if (option == "--threads") {
+            threadCount = static_cast<uint32_t>(strtoul(value, nullptr, 10));
+            ok = threadCount > 0;
+        } else {
+            fprintf(stderr, "Unknown option %s\n", argv[i - 1]);
+            return Usage();
+        }
+        if (!ok) {
+            fprintf(stderr, "Invalid value for %s: %s\n", argv[i - 1], value);
+            return 1;
+        }
+    }
+
+    // Mirror the left eye when only one eye was given.
+    if (!hasFullRight) {
+        headset.fullFov[1] = Mirror(headset.fullFov[0]);
+    }
+    bool isValid = IsValidFov(headset.fullFov[0]) && IsValidFov(headset.fullFov[1]) && !headset.focusRegions.empty();
+    for (auto& region : headset.focusRegions) {
+        if (!region.hasRight) {
+            region.fov[1] = Mirror(region.fov[0]);
+        }
+        if (!region.hasEnvelopeRight) {
+            region.envelope[1] = region.envelope[0];
+        }
+        isValid = isValid && region.size[0] && IsValidFov(region.fov[0]) && IsValidFov(region.fov[1]) &&
+                  region.hasEnvelope >= region.hasEnvelopeRight;
+    }
+    if (!isValid) {
+        fprintf(stderr, "No headset specified\n");
+        return Usage();
+    }
+
+    std::vector<SizingSettings> grid;
+    for (const double ppdScale : ppdScales) {
+        for (const double fovCrop : fovCrops) {
+            for (const double alignment : alignments) {
+                SizingSettings settings;
+                settings.ppdScale = ppdScale;
+                settings.fovCrop = fovCrop;
+                settings.alignment = static_cast<uint32_t>(alignment);
+                grid.push_back(settings);
+            }
+        }
+    }
+
+    if (command == "plan") {
+        if (grid.size() != 1) {
+            fprintf(stderr, "Use the sweep command to evaluate multiple settings\n");
+            return 1;
+        }
+        PrintPlan(Plan(headset, grid[0]));
+    } else {
+        PrintSweepHeader();
+        for (const auto& result : Sweep(headset, grid, threadCount)) {
+            PrintSweepRow(result);
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,112 @@
+// MIT License
+//
+// Copyright(c) 2023 Matthieu Bucchianeri
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this softwareand associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright noticeand this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Client for the Quadinator control channel.
+//   QuadControl <pid> <command> [args...]
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include "control.h"
+
+namespace {
+
+#ifdef _WIN32
+    bool Transact(const std::string& name, const std::string& request, std::string& response) {
+        HANDLE pipe = INVALID_HANDLE_VALUE;
+        while (true) {
+            pipe = CreateFileA(name.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, OPEN_EXISTING, 0, nullptr);
+            if (pipe != INVALID_HANDLE_VALUE || GetLastError() != ERROR_PIPE_BUSY || !WaitNamedPipeA(name.c_str(), 2000)) {
+                break;
+            }
+        }
+        if (pipe == INVALID_HANDLE_VALUE) {
+            return false;
+        }
+
+        DWORD bytesWritten;
+        bool ok = WriteFile(pipe, request.data(), static_cast<DWORD>(request.size()), &bytesWritten, nullptr);
+        char buf[256];
+        DWORD bytesRead;
+        while (ok && ReadFile(pipe, buf, sizeof(buf), &bytesRead, nullptr) && bytesRead) {
+            response.append(buf, bytesRead);
+        }
+        CloseHandle(pipe);
+        return ok;
+    }
+#else
+    bool Transact(const std::string& name, const std::string& request, std::string& response) {
+        const int client = socket(AF_UNIX, SOCK_STREAM, 0);
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        snprintf(address.sun_path, sizeof(address.sun_path), "%s", name.c_str());
+        if (client < 0 || connect(client, reinterpret_cast<sockaddr*>(&address), sizeof(address))) {
+            if (client >= 0) {
+                close(client);
+            }
+            return false;
+        }
+
+        bool ok = write(client, request.data(), request.size()) == static_cast<ssize_t>(request.size());
+        char buf[256];
+        ssize_t bytesRead;
+        while (ok && (bytesRead = read(client, buf, sizeof(buf))) > 0) {
+            response.append(buf, bytesRead);
+        }
+        close(client);
+        return ok;
+    }
+#endif
+
+} // namespace
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        fprintf(stderr, "Usage: QuadControl <pid> <command> [args...]\n       QuadControl <pid> help\n");
+        return 1;
+    }
+
+    const std::string name = quadinator::control::GetEndpointName(static_cast<uint32_t>(strtoul(argv[1], nullptr, 10)));
+    std::string request;
+    for (int i = 2; i < argc; i++) {
+        request += (i > 2 ? " " : "") + std::string(argv[i]);
+    }
+    request += "\n";
+
+    std::string response;
+    if (!Transact(name, request, response)) {
+        fprintf(stderr, "Cannot connect to %s (is control_channel enabled?)\n", name.c_str());
+        return 1;
+    }
+    fputs(response.c_str(), stdout);
+    return response.rfind("error:", 0) == 0 ? 1 : 0;
+}
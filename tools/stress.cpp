@@ -0,0 +1,615 @@
+// MIT License
+//
+// Copyright(c) 2023 Matthieu Bucchianeri
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this softwareand associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright noticeand this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+// Concurrency stress harness: drives the hooks from many threads through a stand-in Varjo runtime, with randomized
+// sessions and layer sets, and reports the throughput by thread count.
+//
+// This harness uses the dispatch table backend of the interposition layer, and only builds on Linux:
+//   g++ -std=c++17 -O2 -rdynamic [-fsanitize=thread] -I. -IVarjo-SDK/include tools/stress.cpp hooks.cpp interpose.cpp
+//       config.cpp control.cpp stats.cpp gaze.cpp gazepoller.cpp gazetrace.cpp focusgrid.cpp sharedgeometry.cpp
+//       arena.cpp -o QuadStress -ldl -pthread
+
+#include <dlfcn.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <random>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <Varjo.h>
+#include <Varjo_layers.h>
+#include <Varjo_math.h>
+
+#include "config.h"
+#include "gaze.h"
+#include "gazetrace.h"
+#include "geometry.h"
+#include "hooks.h"
+#include "sharedgeometry.h"
+
+/////////////////////////////////////////////////////////////////////////////
+// Usage:
+//   QuadStress [--threads N] [--duration S] [--sessions N] [--foveation fixed|dynamic|gaze] [--views N]
+//            [--synthesize 0|1] [--alignment A] [--gaze-seed N | --gaze-trace <trace>]
+//
+// Runs with 1, 2, 4... up to N threads (default: the number of CPUs) for S seconds each (default: 2). The layers have
+// the given number of views (default: 4, the quad views), one more focus region per 2 views. With
+// --synthesize 1, the layers submitted with the stereo views only must reach the runtime as quad views. The
+// carved viewports must lie within the stereo views for any alignment (default: 2). The stand-in eye tracker follows
+// a slow circle, or plays back (looped) a synthesized gaze stream or a recorded trace, with their blinks and tracking
+// losses.
+
+/////////////////////////////////////////////////////////////////////////////
+// The stand-in runtime. Each hooked entry point is routed through its dispatch slot.
+
+namespace {
+
+    // Focus views of about 40 degrees, within a context view of about 100 degrees.
+    constexpr double FocusTangent = 0.36;
+
+    // The views of the layers, set before the first session.
+    int32_t g_viewCount = quadinator::DefaultViewCount;
+    bool g_synthesizeFocusViews = false;
+    uint32_t g_alignment = 2;
+
+    // The samples played back by the stand-in eye tracker, set before the first session. Empty for the circle. Never
+    // destroyed, since the gaze pollers of the sessions run until the process exits.
+    std::vector<varjo_Gaze>& g_gazeSamples = *new std::vector<varjo_Gaze>;
+    int64_t g_gazeStartTime = 0;
+
+    // Length of the synthesized gaze stream, looped.
+    constexpr double GazeSynthesisDuration = 60.0;
+
+    // The focus regions get narrower, one within the other.
+    double GetFocusTangent(int32_t viewIndex) {
+        return FocusTangent / (1 + (viewIndex - quadinator::StereoViewCount) / quadinator::StereoViewCount);
+    }
+
+    // An extension type unknown to Quadinator, at the end of the chains.
+    constexpr varjo_ViewExtensionType UnknownExtensionType = 0x7f;
+
+    // Layers submitted by the application, and received by the runtime.
+    std::atomic<uint64_t> g_submittedLayers{0};
+    std::atomic<uint64_t> g_receivedLayers{0};
+    std::atomic<uint64_t> g_carvingErrors{0};
+
+    varjo_FovTangents FullFovTangents(int32_t viewIndex) {
+        // Canted displays: the inner side is narrower.
+        return viewIndex % 2 == 0 ? varjo_FovTangents{1.0, -1.1, -1.25, 1.0}
+                                  : varjo_FovTangents{1.0, -1.1, -1.0, 1.25};
+    }
+
+    void StandIn_GetTextureSize([[maybe_unused]] varjo_Session* session,
+                                varjo_TextureSize_Type type,
+                                int32_t viewIndex,
+                                int32_t* width,
+                                int32_t* height) {
+        *width = viewIndex < 2 || type == varjo_TextureSize_Type_Stereo ? 2880 : 1920;
+        *height = viewIndex < 2 || type == varjo_TextureSize_Type_Stereo ? 2720 : 1920;
+    }
+
+    varjo_ViewDescription StandIn_GetViewDescription(varjo_Session* session, int32_t viewIndex) {
+        varjo_ViewDescription result{};
+        StandIn_GetTextureSize(session, varjo_TextureSize_Type_Quad, viewIndex, &result.width, &result.height);
+        return result;
+    }
+
+    bool IsCarvedWithin(const varjo_SwapChainViewport& focus, const varjo_SwapChainViewport& reference) {
+        return focus.swapChain == reference.swapChain && focus.arrayIndex == reference.arrayIndex && focus.width > 1 &&
+               focus.height > 1 && focus.x >= reference.x && focus.y >= reference.y &&
+               focus.x + focus.width <= reference.x + reference.width &&
+               focus.y + focus.height <= reference.y + reference.height;
+    }
+
+    // The extension viewport is carved out of its reference like the color viewport (up to the alignment, and the
+    // clamping to the reference).
+    bool IsCarvedLike(const varjo_SwapChainViewport& focus,
+                      const varjo_SwapChainViewport& reference,
+                      const varjo_SwapChainViewport& focusColor,
+                      const varjo_SwapChainViewport& referenceColor) {
+        const auto fraction = [](int32_t n, int32_t total) { return static_cast<double>(n) / total; };
+        const int32_t alignment = static_cast<int32_t>(g_alignment) + 1;
+        const double tolerance = fraction(alignment, reference.width) + fraction(alignment, referenceColor.width);
+        return IsCarvedWithin(focus, reference) &&
+               std::abs(fraction(focus.x - reference.x, reference.width) -
+                        fraction(focusColor.x - referenceColor.x, referenceColor.width)) < tolerance &&
+               std::abs(fraction(focus.width, reference.width) - fraction(focusColor.width, referenceColor.width)) <
+                   tolerance &&
+               std::abs(fraction(focus.y - reference.y, reference.height) -
+                        fraction(focusColor.y - referenceColor.y, referenceColor.height)) < tolerance &&
+               std::abs(fraction(focus.height, reference.height) -
+                        fraction(focusColor.height, referenceColor.height)) < tolerance;
+    }
+
+    template <typename Extension>
+    const Extension* FindExtension(const varjo_LayerMultiProjView& view, varjo_ViewExtensionType type) {
+        for (const varjo_ViewExtension* extension = view.extension; extension; extension = extension->next) {
+            if (extension->type == type) {
+                return reinterpret_cast<const Extension*>(extension);
+            }
+        }
+        return nullptr;
+    }
+
+    void StandIn_EndFrameWithLayers([[maybe_unused]] varjo_Session* session, varjo_SubmitInfoLayers* submitInfo) {
+        g_receivedLayers.fetch_add(submitInfo->layerCount, std::memory_order_relaxed);
+        for (int32_t i = 0; i < submitInfo->layerCount; i++) {
+            if (submitInfo->layers[i]->type != varjo_LayerMultiProjType) {
+                continue;
+            }
+            const auto* proj = reinterpret_cast<const varjo_LayerMultiProj*>(submitInfo->layers[i]);
+            if (g_synthesizeFocusViews && proj->viewCount < quadinator::DefaultViewCount) {
+                g_carvingErrors.fetch_add(1, std::memory_order_relaxed);
+            }
+            for (int32_t k = 2; k < proj->viewCount; k++) {
+                // The carved focus view must lie within its reference view, and so must its depth and velocity.
+                const auto& focus = proj->views[k];
+                const auto& reference = proj->views[k % 2];
+                if (!IsCarvedWithin(focus.viewport, reference.viewport)) {
+                    g_carvingErrors.fetch_add(1, std::memory_order_relaxed);
+                }
+                const auto* focusDepth = FindExtension<varjo_ViewExtensionDepth>(focus, varjo_ViewExtensionDepthType);
+                const auto* referenceDepth =
+                    FindExtension<varjo_ViewExtensionDepth>(reference, varjo_ViewExtensionDepthType);
+                if (!referenceDepth != !focusDepth ||
+                    (focusDepth && (!IsCarvedLike(focusDepth->viewport,
+                                                  referenceDepth->viewport,
+                                                  focus.viewport,
+                                                  reference.viewport) ||
+                                    focusDepth->nearZ != referenceDepth->nearZ))) {
+                    g_carvingErrors.fetch_add(1, std::memory_order_relaxed);
+                }
+                const auto* focusVelocity =
+                    FindExtension<varjo_ViewExtensionVelocity>(focus, varjo_ViewExtensionVelocityType);
+                const auto* referenceVelocity =
+                    FindExtension<varjo_ViewExtensionVelocity>(reference, varjo_ViewExtensionVelocityType);
+                if (!referenceVelocity != !focusVelocity ||
+                    (focusVelocity && (!IsCarvedLike(focusVelocity->viewport,
+                                                     referenceVelocity->viewport,
+                                                     focus.viewport,
+                                                     reference.viewport) ||
+                                       focusVelocity->velocityScale != referenceVelocity->velocityScale))) {
+                    g_carvingErrors.fetch_add(1, std::memory_order_relaxed);
+                }
+                // The extensions that are not carved are passed through.
+                if ((focusDepth || focusVelocity) &&
+                    FindExtension<varjo_ViewExtension>(focus, UnknownExtensionType) !=
+                        FindExtension<varjo_ViewExtension>(reference, UnknownExtensionType)) {
+                    g_carvingErrors.fetch_add(1, std::memory_order_relaxed);
+                }
+            }
+        }
+    }
+
+    void StandIn_SessionShutDown([[maybe_unused]] varjo_Session* session) {
+    }
+
+} // namespace
+
+extern "C" {
+
+std::atomic<void*> varjo_GetTextureSize_dispatch{reinterpret_cast<void*>(&StandIn_GetTextureSize)};
+std::atomic<void*> varjo_GetViewDescription_dispatch{reinterpret_cast<void*>(&StandIn_GetViewDescription)};
+std::atomic<void*> varjo_EndFrameWithLayers_dispatch{reinterpret_cast<void*>(&StandIn_EndFrameWithLayers)};
+std::atomic<void*> varjo_SessionShutDown_dispatch{reinterpret_cast<void*>(&StandIn_SessionShutDown)};
+
+void varjo_GetTextureSize(
+    varjo_Session* session, varjo_TextureSize_Type type, int32_t viewIndex, int32_t* width, int32_t* height) {
+    reinterpret_cast<decltype(&StandIn_GetTextureSize)>(varjo_GetTextureSize_dispatch.load(std::memory_order_relaxed))(
+        session, type, viewIndex, width, height);
+}
+
+varjo_ViewDescription varjo_GetViewDescription(varjo_Session* session, int32_t viewIndex) {
+    return reinterpret_cast<decltype(&StandIn_GetViewDescription)>(
+        varjo_GetViewDescription_dispatch.load(std::memory_order_relaxed))(session, viewIndex);
+}
+
+void varjo_EndFrameWithLayers(varjo_Session* session, varjo_SubmitInfoLayers* submitInfo) {
+    reinterpret_cast<decltype(&StandIn_EndFrameWithLayers)>(
+        varjo_EndFrameWithLayers_dispatch.load(std::memory_order_relaxed))(session, submitInfo);
+}
+
+void varjo_SessionShutDown(varjo_Session* session) {
+    reinterpret_cast<decltype(&StandIn_SessionShutDown)>(
+        varjo_SessionShutDown_dispatch.load(std::memory_order_relaxed))(session);
+}
+
+varjo_FovTangents varjo_GetFovTangents([[maybe_unused]] varjo_Session* session, int32_t viewIndex) {
+    const double focusTangent = GetFocusTangent(viewIndex);
+    return viewIndex < 2 ? FullFovTangents(viewIndex)
+                         : varjo_FovTangents{focusTangent, -focusTangent, -focusTangent, focusTangent};
+}
+
+varjo_FovTangents varjo_GetFoveatedFovTangents([[maybe_unused]] varjo_Session* session,
+                                               int32_t viewIndex,
+                                               varjo_Gaze* gaze,
+                                               [[maybe_unused]] varjo_FoveatedFovTangents_Hints* hints) {
+    if (viewIndex < 2) {
+        return FullFovTangents(viewIndex);
+    }
+
+    // The focus region follows the gaze, within the context view. The gain lets the focus reach the edges of the
+    // context view, where the carved viewports must not overflow the stereo views.
+    constexpr double Gain = 4.0;
+    const auto full = FullFovTangents(viewIndex);
+    const double focusTangent = GetFocusTangent(viewIndex);
+    const auto angles = quadinator::gaze::ToAngles(gaze->gaze);
+    constexpr double RadiansPerDegree = 3.14159265358979323846 / 180.0;
+    const double x = std::clamp(Gain * std::tan(angles.yaw * RadiansPerDegree),
+                                full.left + focusTangent,
+                                full.right - focusTangent);
+    const double y = std::clamp(Gain * std::tan(angles.pitch * RadiansPerDegree),
+                                full.bottom + focusTangent,
+                                full.top - focusTangent);
+    return {y + focusTangent, y - focusTangent, x - focusTangent, x + focusTangent};
+}
+
+int32_t varjo_GetViewCount([[maybe_unused]] varjo_Session* session) {
+    return g_viewCount;
+}
+
+varjo_Bool varjo_GetRenderingGaze([[maybe_unused]] varjo_Session* session, varjo_Gaze* gaze) {
+    const int64_t now =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+    if (!g_gazeSamples.empty()) {
+        // The sample at the same time within the loop.
+        const int64_t firstTime = g_gazeSamples.front().captureTime;
+        const int64_t loopTime = g_gazeSamples.back().captureTime - firstTime + 1;
+        const int64_t time = firstTime + (now - g_gazeStartTime) % loopTime;
+        const auto next = std::upper_bound(
+            g_gazeSamples.cbegin(), g_gazeSamples.cend(), time, [](int64_t time, const varjo_Gaze& sample) {
+                return time < sample.captureTime;
+            });
+        *gaze = *std::prev(next);
+        gaze->captureTime = now;
+        return 1;
+    }
+
+    // A slow circular motion, so that the focus moves regularly.
+    const double phase = (now % 2000000000) / 2e9 * 2 * 3.14159265358979323846;
+    *gaze = {};
+    for (varjo_Ray* ray : {&gaze->leftEye, &gaze->rightEye, &gaze->gaze}) {
+        quadinator::gaze::FromAngles({15 * std::cos(phase), 10 * std::sin(phase)}, *ray);
+    }
+    gaze->leftStatus = gaze->rightStatus = 3;
+    gaze->stability = 1.0;
+    gaze->status = 2;
+    gaze->captureTime = now;
+    return 1;
+}
+
+varjo_Nanoseconds varjo_FrameGetDisplayTime([[maybe_unused]] varjo_Session* session) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+               .count() +
+           20000000;
+}
+
+varjo_Matrix varjo_GetProjectionMatrix(varjo_FovTangents* tangents) {
+    // Column-major, off-axis projection (the depth terms do not matter here).
+    varjo_Matrix m{};
+    m.value[0] = 2 / (tangents->right - tangents->left);
+    m.value[5] = 2 / (tangents->top - tangents->bottom);
+    m.value[8] = (tangents->right + tangents->left) / (tangents->right - tangents->left);
+    m.value[9] = (tangents->top + tangents->bottom) / (tangents->top - tangents->bottom);
+    m.value[10] = -1;
+    m.value[11] = -1;
+    return m;
+}
+
+varjo_AlignedView varjo_GetAlignedView(double* projectionMatrix) {
+    varjo_AlignedView view{};
+    view.projectionRight = (projectionMatrix[8] + 1) / projectionMatrix[0];
+    view.projectionLeft = -(projectionMatrix[8] - 1) / projectionMatrix[0];
+    view.projectionTop = (projectionMatrix[9] + 1) / projectionMatrix[5];
+    view.projectionBottom = -(projectionMatrix[9] - 1) / projectionMatrix[5];
+    return view;
+}
+
+} // extern "C"
+
+/////////////////////////////////////////////////////////////////////////////
+// The application side.
+
+namespace {
+
+    struct Counters {
+        std::atomic<uint64_t> calls{0};
+        std::atomic<uint64_t> frames{0};
+        std::atomic<uint64_t> shutdowns{0};
+    };
+
+    struct ViewExtensions {
+        varjo_ViewExtension unknown;
+        varjo_ViewExtensionDepth depth;
+        varjo_ViewExtensionDepthTestRange depthTestRange;
+        varjo_ViewExtensionVelocity velocity;
+    };
+
+    // One frame with a random set of layers: stereo views followed by the focus views to carve, or stereo views only,
+    // with or without depth and velocity, and sometimes a layer of another type.
+    void SubmitFrame(varjo_Session* session, std::mt19937& random, int64_t frameNumber) {
+        static varjo_SwapChain* const swapChain = reinterpret_cast<varjo_SwapChain*>(0x1000);
+        static varjo_SwapChain* const depthSwapChain = reinterpret_cast<varjo_SwapChain*>(0x2000);
+        static varjo_SwapChain* const velocitySwapChain = reinterpret_cast<varjo_SwapChain*>(0x3000);
+
+        const int layerCount = 1 + random() % 3;
+        std::vector<varjo_LayerMultiProj> projections(layerCount);
+        std::vector<std::array<varjo_LayerMultiProjView, quadinator::MaxViewCount>> views(layerCount);
+        std::vector<std::array<ViewExtensions, quadinator::MaxViewCount>> extensions(layerCount);
+        std::vector<varjo_LayerHeader> otherLayers(layerCount);
+        std::vector<varjo_LayerHeader*> layers;
+        for (int i = 0; i < layerCount; i++) {
+            if (random() % 8 == 0) {
+                otherLayers[i].type = varjo_LayerMultiProjType + 1;
+                layers.push_back(&otherLayers[i]);
+                continue;
+            }
+
+            auto& proj = projections[i];
+            proj.header.type = varjo_LayerMultiProjType;
+            proj.viewCount = random() % 4 == 0 ? 2 : g_viewCount;
+            proj.views = views[i].data();
+            const bool hasDepth = random() % 2;
+            const bool hasVelocity = random() % 4 == 0;
+            const bool hasUnknown = random() % 4 == 0;
+            for (int32_t k = 0; k < proj.viewCount; k++) {
+                auto& view = views[i][k];
+                view = {};
+                auto tangents = varjo_GetFovTangents(session, k % 2);
+                view.projection = varjo_GetProjectionMatrix(&tangents);
+                view.viewport.swapChain = swapChain;
+                // The stereo views are side by side in the swapchain.
+                view.viewport.x = k == 1 ? 2880 : 0;
+                // This is how the focus views are submitted for carving.
+                view.viewport.width = k < 2 ? 2880 : 1;
+                view.viewport.height = k < 2 ? 2720 : 1;
+                // The depth is at half resolution, and chained after the velocity.
+                auto& extension = extensions[i][k];
+                extension = {};
+                if (hasUnknown) {
+                    extension.unknown.type = UnknownExtensionType;
+                    view.extension = &extension.unknown;
+                }
+                if (hasDepth) {
+                    extension.depthTestRange.header.type = varjo_ViewExtensionDepthTestRangeType;
+                    extension.depthTestRange.header.next = view.extension;
+                    extension.depth.header.type = varjo_ViewExtensionDepthType;
+                    extension.depth.header.next = &extension.depthTestRange.header;
+                    extension.depth.nearZ = 0.1;
+                    extension.depth.farZ = 100.0;
+                    extension.depth.viewport = view.viewport;
+                    extension.depth.viewport.swapChain = depthSwapChain;
+                    extension.depth.viewport.x = view.viewport.x / 2;
+                    extension.depth.viewport.width = k < 2 ? 1440 : 1;
+                    extension.depth.viewport.height = k < 2 ? 1360 : 1;
+                    view.extension = &extension.depth.header;
+                }
+                if (hasVelocity) {
+                    extension.velocity.header.type = varjo_ViewExtensionVelocityType;
+                    extension.velocity.header.next = view.extension;
+                    extension.velocity.velocityScale = 0.5;
+                    extension.velocity.viewport = view.viewport;
+                    extension.velocity.viewport.swapChain = velocitySwapChain;
+                    view.extension = &extension.velocity.header;
+                }
+            }
+            layers.push_back(&proj.header);
+        }
+
+        varjo_SubmitInfoLayers submitInfo{};
+        submitInfo.frameNumber = frameNumber;
+        submitInfo.layerCount = layerCount;
+        submitInfo.layers = layers.data();
+        g_submittedLayers.fetch_add(layerCount, std::memory_order_relaxed);
+        varjo_EndFrameWithLayers(session, &submitInfo);
+    }
+
+    // The application side of a session. A session submits its frames from one thread at a time, and is not shut down
+    // while submitting a frame. The other entry points may be called from any thread.
+    struct Session {
+        varjo_Session* session;
+        std::mutex frameMutex;
+    };
+
+    void Worker(uint32_t seed, std::vector<Session>& sessions, const std::atomic<bool>& stop, Counters& counters) {
+        std::mt19937 random(seed);
+        int64_t frameNumber = 0;
+        uint64_t calls = 0;
+        uint64_t frames = 0;
+        uint64_t shutdowns = 0;
+        while (!stop.load(std::memory_order_relaxed)) {
+            auto& entry = sessions[random() % sessions.size()];
+            varjo_Session* session = entry.session;
+            // The sessions are shut down rarely enough that the eye tracking is acquired (see GazeFallback).
+            uint32_t action = random() % 10000;
+            std::unique_lock frameLock(entry.frameMutex, std::defer_lock);
+            if ((action < 6000 || action >= 9999) && !frameLock.try_lock()) {
+                // Another thread is the render thread of the session for now.
+                action = 6000;
+            }
+            if (action < 6000) {
+                SubmitFrame(session, random, frameNumber++);
+                frames++;
+            } else if (action < 8000) {
+                (void)varjo_GetViewDescription(session, random() % 2);
+            } else if (action < 9999) {
+                int32_t width, height;
+                varjo_GetTextureSize(session, varjo_TextureSize_Type_Stereo, random() % 2, &width, &height);
+            } else {
+                // The state is created again on the next use of the session.
+                varjo_SessionShutDown(session);
+                shutdowns++;
+            }
+            calls++;
+        }
+        counters.calls.fetch_add(calls, std::memory_order_relaxed);
+        counters.frames.fetch_add(frames, std::memory_order_relaxed);
+        counters.shutdowns.fetch_add(shutdowns, std::memory_order_relaxed);
+    }
+
+    int Usage() {
+        fprintf(stderr,
+                "Usage:\n"
+                "  QuadStress [--threads N] [--duration S] [--sessions N] [--foveation fixed|dynamic|gaze] "
+                "[--views N] [--synthesize 0|1] [--alignment A] [--gaze-seed N | --gaze-trace <trace>]\n");
+        return 1;
+    }
+
+} // namespace
+
+int main(int argc, char** argv) {
+    uint32_t maxThreads = std::max(1u, std::thread::hardware_concurrency());
+    double duration = 2.0;
+    uint32_t sessionCount = 4;
+    std::string foveation = "gaze";
+    std::string gazeSource = "circle";
+    for (int i = 1; i < argc; i++) {
+        const std::string_view option(argv[i]);
+        if (i + 1 >= argc) {
+            return Usage();
+        }
+        const char* value = argv[++i];
+        if (option == "--threads") {
+            maxThreads = std::max(1, atoi(value));
+        } else if (option == "--duration") {
+            duration = strtod(value, nullptr);
+        } else if (option == "--sessions") {
+            sessionCount = std::max(1, atoi(value));
+        } else if (option == "--foveation") {
+            foveation = value;
+        } else if (option == "--views") {
+            g_viewCount = atoi(value);
+            if (g_viewCount < quadinator::DefaultViewCount || g_viewCount > quadinator::MaxViewCount ||
+                g_viewCount % quadinator::StereoViewCount) {
+                return Usage();
+            }
+        } else if (option == "--synthesize") {
+            g_synthesizeFocusViews = atoi(value);
+        } else if (option == "--alignment") {
+            g_alignment = static_cast<uint32_t>(strtoul(value, nullptr, 10));
+            if (!quadinator::IsValidAlignment(g_alignment)) {
+                return Usage();
+            }
+        } else if (option == "--gaze-seed") {
+            quadinator::gaze::GazeSynthesizer synthesizer(static_cast<uint32_t>(strtoul(value, nullptr, 10)));
+            const double rate = quadinator::gaze::SynthesisSettings{}.rate;
+            g_gazeSamples.resize(static_cast<size_t>(GazeSynthesisDuration * rate));
+            std::generate(g_gazeSamples.begin(), g_gazeSamples.end(), [&] { return synthesizer.Next(); });
+            gazeSource = "synthesized (seed " + std::string(value) + ")";
+        } else if (option == "--gaze-trace") {
+            if (!quadinator::gaze::LoadTrace(value, g_gazeSamples) || g_gazeSamples.empty()) {
+                fprintf(stderr, "Cannot load trace %s\n", value);
+                return 1;
+            }
+            std::stable_sort(
+                g_gazeSamples.begin(), g_gazeSamples.end(), [](const varjo_Gaze& a, const varjo_Gaze& b) {
+                    return a.captureTime < b.captureTime;
+                });
+            gazeSource = value;
+        } else {
+            return Usage();
+        }
+    }
+
+    // The configuration is read from a private folder, as if it was next to the DLL.
+    const auto root = std::filesystem::temp_directory_path() / ("QuadStress-" + std::to_string(getpid()));
+    std::filesystem::create_directories(root);
+    std::ofstream(root / quadinator::config::ConfigFileName)
+        << "foveation = " << foveation << "\n"
+        << "synthesize_focus_views = " << g_synthesizeFocusViews << "\n"
+        << "alignment = " << g_alignment << "\n";
+    // Start without the geometry published by a previous run.
+    quadinator::shared::GeometrySegment::Unlink();
+    quadinator::hooks::SetProcessInfo(root, "QuadStress");
+    if (!quadinator::hooks::Attach(dlopen(nullptr, RTLD_NOW), false)) {
+        fprintf(stderr, "Cannot attach the hooks (the harness must be linked with -rdynamic)\n");
+        return 1;
+    }
+
+    std::vector<Session> sessions(sessionCount);
+    for (uint32_t i = 0; i < sessionCount; i++) {
+        sessions[i].session = reinterpret_cast<varjo_Session*>((i + 1) * uintptr_t(0x10000));
+    }
+
+    g_gazeStartTime =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+    printf("Foveation: %s, gaze: %s, %u sessions, %.1f s per run\n",
+           foveation.c_str(),
+           gazeSource.c_str(),
+           sessionCount,
+           duration);
+    double baseline = 0;
+    for (uint32_t threadCount = 1; threadCount <= maxThreads; threadCount = threadCount < maxThreads
+                                                                                ? std::min(threadCount * 2, maxThreads)
+                                                                                : threadCount + 1) {
+        Counters counters;
+        std::atomic<bool> stop{false};
+        std::vector<std::thread> threads;
+        const auto start = std::chrono::steady_clock::now();
+        for (uint32_t i = 0; i < threadCount; i++) {
+            threads.emplace_back(Worker, i + 1, std::ref(sessions), std::cref(stop), std::ref(counters));
+        }
+        std::this_thread::sleep_for(std::chrono::duration<double>(duration));
+        stop = true;
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        const double rate = counters.calls / elapsed;
+        if (threadCount == 1) {
+            baseline = rate;
+        }
+        printf("threads=%-3u calls/s=%-10.0f per_thread=%-10.0f scaling=%.2f frames=%llu shutdowns=%llu\n",
+               threadCount,
+               rate,
+               rate / threadCount,
+               baseline ? rate / baseline : 0.0,
+               static_cast<unsigned long long>(counters.frames.load()),
+               static_cast<unsigned long long>(counters.shutdowns.load()));
+    }
+
+    const uint64_t dropped = g_submittedLayers.load() - g_receivedLayers.load();
+    printf("Layers: %llu submitted, %llu dropped by the hooks. Carving errors: %llu\n",
+           static_cast<unsigned long long>(g_submittedLayers.load()),
+           static_cast<unsigned long long>(dropped),
+           static_cast<unsigned long long>(g_carvingErrors.load()));
+
+    std::filesystem::remove_all(root);
+    quadinator::shared::GeometrySegment::Unlink();
+    return g_carvingErrors ? 1 : 0;
+}